@@ -0,0 +1,232 @@
+#include "batch.h"
+#include "solver.h"
+
+#include <stdint.h>
+#include <string.h>
+
+// Candidate masks are laid out structure-of-arrays: cand[cell] holds the
+// masks of that cell for all BATCH_LANES puzzles side by side. Propagation
+// (peer elimination + hidden singles) runs on whole cells at a time, and
+// puzzles it cannot finish are handed to the scalar MRV solver with the
+// deductions already made.
+
+#if defined(__GNUC__) || defined(__clang__)
+#define BATCH_VECTOR 1
+typedef uint16_t lanes_t __attribute__((vector_size(BATCH_LANES * sizeof(uint16_t)), aligned(32)));
+#endif
+
+#if defined(BATCH_VECTOR) && (defined(__x86_64__) || defined(__i386__))
+#define BATCH_X86 1
+#endif
+
+// Cap on sweeps per group. A sweep that changes anything removes at least
+// one candidate, so propagation always ends, but it can run past the cap by
+// eliminating without filling cells; lanes it leaves open go to the scalar
+// solver and finished ones are checked.
+#define MAX_SWEEPS SOLVER_CELLS
+
+#ifdef BATCH_VECTOR
+
+typedef struct {
+    lanes_t cand[SOLVER_CELLS];
+} BatchGroup;
+
+// Mask of the value if exactly one candidate is left, else 0
+#define SINGLE(x) ((x) & (lanes_t)((((x) & ((x) - 1)) == 0)))
+
+// Shared body of every vector kernel; each wrapper below compiles it for
+// a different instruction set.
+static inline __attribute__((always_inline)) bool sweep_body(BatchGroup *g)
+{
+    const lanes_t all = (lanes_t){0} + SOLVER_ALL_DIGITS;
+    lanes_t changed = {0};
+    lanes_t single[SOLVER_CELLS];
+
+    for (int cell = 0; cell < SOLVER_CELLS; cell++)
+        single[cell] = SINGLE(g->cand[cell]);
+
+    // A value fixed in one cell is removed from its 20 peers. Two equal
+    // singles in a unit wipe each other out, which flags the lane dead.
+    for (int cell = 0; cell < SOLVER_CELLS; cell++) {
+        const uint8_t *peers = solver_peers[cell];
+        lanes_t taken = {0};
+        for (int p = 0; p < SOLVER_PEERS; p++)
+            taken |= single[peers[p]];
+
+        lanes_t old = g->cand[cell];
+        lanes_t now = old & ~taken;
+        changed |= old ^ now;
+        g->cand[cell] = now;
+    }
+
+    // A value with exactly one possible cell in a unit goes there
+    for (int u = 0; u < SOLVER_UNITS; u++) {
+        const uint8_t *unit = solver_units[u];
+        lanes_t once = {0}, twice = {0};
+
+        for (int i = 0; i < BOARDSIZE; i++) {
+            lanes_t c = g->cand[unit[i]];
+            twice |= once & c;
+            once  |= c;
+        }
+
+        lanes_t hidden = once & ~twice;
+        // Values with no cell left at all: clear the unit so the lane reads
+        // as contradicted
+        lanes_t dead = (lanes_t)(once != all);
+
+        for (int i = 0; i < BOARDSIZE; i++) {
+            lanes_t old = g->cand[unit[i]];
+            lanes_t hit = old & hidden;
+            lanes_t forced = (lanes_t)(hit != 0);
+            lanes_t now = ((hit & forced) | (old & ~forced)) & ~dead;
+            changed |= old ^ now;
+            g->cand[unit[i]] = now;
+        }
+    }
+
+    lanes_t zero = {0};
+    return memcmp(&changed, &zero, sizeof(changed)) != 0;
+}
+
+#ifdef BATCH_X86
+__attribute__((target("avx2")))
+static bool sweep_avx2(BatchGroup *g) { return sweep_body(g); }
+
+__attribute__((target("sse4.1")))
+static bool sweep_sse41(BatchGroup *g) { return sweep_body(g); }
+#endif
+
+static bool sweep_generic(BatchGroup *g) { return sweep_body(g); }
+
+typedef bool (*SweepFn)(BatchGroup *g);
+
+static SweepFn pick_kernel(const char **name)
+{
+#ifdef BATCH_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        *name = "avx2";
+        return sweep_avx2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        *name = "sse4.1";
+        return sweep_sse41;
+    }
+    *name = "sse2";
+#else
+    *name = "generic";
+#endif
+    return sweep_generic;
+}
+
+static void load_group(BatchGroup *g, Board *boards, int count)
+{
+    for (int cell = 0; cell < SOLVER_CELLS; cell++) {
+        for (int lane = 0; lane < BATCH_LANES; lane++) {
+            uint16_t mask = SOLVER_ALL_DIGITS;
+            if (lane < count) {
+                int v = boards[lane][cell / BOARDSIZE][cell % BOARDSIZE];
+                if (v < 0 || v > 9)
+                    mask = 0;
+                else if (v > 0)
+                    mask = (uint16_t)(1u << (v - 1));
+            }
+            g->cand[cell][lane] = mask;
+        }
+    }
+}
+
+// True if no two peers hold the same value. A sweep wipes out such a pair,
+// but the last one before MAX_SWEEPS may have created it.
+static bool lane_consistent(const BatchGroup *g, int lane)
+{
+    for (int cell = 0; cell < SOLVER_CELLS; cell++) {
+        const uint8_t *peers = solver_peers[cell];
+        for (int p = 0; p < SOLVER_PEERS; p++) {
+            if (g->cand[peers[p]][lane] == g->cand[cell][lane])
+                return false;
+        }
+    }
+    return true;
+}
+
+// Finishes one lane on the scalar path if propagation stopped short and
+// copies it back into its board. Returns whether the board is solved; like
+// the scalar engines, an unsolved board is left as it came in.
+static bool finish_lane(const BatchGroup *g, int lane, Board b)
+{
+    Board work;
+    bool complete = true;
+
+    for (int cell = 0; cell < SOLVER_CELLS; cell++) {
+        unsigned m = g->cand[cell][lane];
+        if (m == 0)
+            return false;
+        if (m & (m - 1)) {
+            work[cell / BOARDSIZE][cell % BOARDSIZE] = 0;
+            complete = false;
+        } else {
+            work[cell / BOARDSIZE][cell % BOARDSIZE] = solver_lowest_digit(m) + 1;
+        }
+    }
+
+    if (complete ? !lane_consistent(g, lane) : !solve_with(work, SOLVER_MRV))
+        return false;
+    memcpy(b, work, sizeof(work));
+    return true;
+}
+
+int solve_batch(Board *boards, int n, bool *solved)
+{
+    const char *kernel_name;
+    SweepFn sweep = pick_kernel(&kernel_name);
+
+    BatchGroup g;
+    int total = 0;
+
+    for (int base = 0; base < n; base += BATCH_LANES) {
+        int count = n - base < BATCH_LANES ? n - base : BATCH_LANES;
+
+        load_group(&g, boards + base, count);
+        for (int i = 0; i < MAX_SWEEPS && sweep(&g); i++)
+            ;
+
+        for (int lane = 0; lane < count; lane++) {
+            bool ok = finish_lane(&g, lane, boards[base + lane]);
+            if (solved)
+                solved[base + lane] = ok;
+            total += ok;
+        }
+    }
+
+    return total;
+}
+
+const char *solve_batch_kernel(void)
+{
+    const char *name;
+    pick_kernel(&name);
+    return name;
+}
+
+#else // !BATCH_VECTOR
+
+int solve_batch(Board *boards, int n, bool *solved)
+{
+    int total = 0;
+    for (int i = 0; i < n; i++) {
+        bool ok = solve_with(boards[i], SOLVER_MRV);
+        if (solved)
+            solved[i] = ok;
+        total += ok;
+    }
+    return total;
+}
+
+const char *solve_batch_kernel(void)
+{
+    return "scalar";
+}
+
+#endif // BATCH_VECTOR
@@ -0,0 +1,19 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "board.h"
+#include <stdbool.h>
+
+// Puzzles propagated together; one 16-bit candidate mask per lane, so one
+// cell of a whole group fits a 256-bit register.
+#define BATCH_LANES 16
+
+// Solves n boards in place. solved[i] (may be NULL) tells whether boards[i]
+// was solved. Returns the number of boards solved.
+int solve_batch(Board *boards, int n, bool *solved);
+
+// Name of the propagation kernel picked for this CPU ("avx2", "sse4.1",
+// "sse2", "generic" or "scalar")
+const char *solve_batch_kernel(void);
+
+#endif //BATCH_H
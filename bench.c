@@ -0,0 +1,446 @@
+// sudoku_bench: runs every solver engine over a few puzzle sets and reports
+// throughput, per-puzzle latency percentiles and search nodes, then does
+// the same for the puzzle generator at each difficulty.
+//
+//   sudoku_bench [--csv PATH] [--limit N] [--generated N] [--budget SECONDS]
+//                [--engines a,b,..] [--sets a,b,..] [--json FILE|-]
+
+#include "board.h"
+#include "solver.h"
+#include "batch.h"
+#include "generator.h"
+#include "puzzledb.h"
+#include "timeutil.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#define ENGINE_BATCH -1
+
+typedef struct {
+    const char *name;
+    int engine;         // SolverEngine, or ENGINE_BATCH for solve_batch()
+} BenchEngine;
+
+static const BenchEngine engines[] = {
+    { "backtrack", SOLVER_BACKTRACK },
+    { "dlx",       SOLVER_DLX },
+    { "mrv",       SOLVER_MRV },
+    { "batch",     ENGINE_BATCH }
+};
+
+typedef struct {
+    const char *name;
+    Board *puzzles;
+    int count;
+} PuzzleSet;
+
+typedef struct {
+    const char *set;
+    const char *engine;
+    int attempted;
+    int solved;
+    double secs;
+    uint64_t p50_ns;
+    uint64_t p99_ns;
+    uint64_t max_ns;
+    uint64_t nodes;
+    bool cut_short;     // stopped by the time budget
+} BenchResult;
+
+// Known 17-clue puzzles, each with a unique solution
+static const char *const hard17[] = {
+    "000000010400000000020000000000050407008000300001090000300400200050100000000806000",
+    "000000010400000000020000000000050604008000300001090000300400200050100000000807000",
+    "000000012000035000000600070700000300000400800100000000000120000080000040050000600",
+    "000000012003600000000007000410020000000500300700000600280000040000300500000000000",
+    "000000012008030000000000040120500000000004700060000000507000300000620000000100000",
+    "000000012040050000000009000070600400000100000000000050000087500601000300200000000",
+    "000000012050400000000000030700600400001000000000080000920000800000510700000003000",
+    "000000013000030080070000000000206000030000900000010000600500204000400700100000000",
+    "000000013000200000000000080000760200008000400010000000200000750600340000000008000",
+    "000000013000500070000802000000400900107000000000000200890000050040000600000010000",
+    "000000013000700060000508000000400800106000000000000200740000050020000400000010000",
+    "000000013000700060000509000000400900106000000000000200740000050080000400000010000",
+    "000000013000800070000502000000400900107000000000000200890000050040000600000010000"
+};
+
+// Built so that the first row of the solution is 987654321, which makes
+// first-cell, lowest-value-first backtracking try almost everything
+static const char *const anti_backtrack =
+    "000000000000003085001020000000507000004000100090000000500000073002010000000040009";
+
+static bool in_list(const char *list, const char *name)
+{
+    if (!list)
+        return true;
+    size_t n = strlen(name);
+    for (const char *p = list; (p = strstr(p, name)) != NULL; p += n) {
+        bool starts = p == list || p[-1] == ',';
+        bool ends = p[n] == '\0' || p[n] == ',';
+        if (starts && ends)
+            return true;
+    }
+    return false;
+}
+
+static Board *alloc_boards(int n)
+{
+    Board *b = malloc((size_t)(n > 0 ? n : 1) * sizeof(Board));
+    if (!b) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    return b;
+}
+
+static PuzzleSet load_csv(const char *path, int limit)
+{
+    PuzzleSet set = { "csv", NULL, 0 };
+    PuzzleDb db;
+
+    if (!puzzledb_open(&db, path)) {
+        fprintf(stderr, "bench: could not open %s, skipping csv set\n", path);
+        return set;
+    }
+
+    int n = (int)db.count;
+    if (limit > 0 && n > limit)
+        n = limit;
+
+    set.puzzles = alloc_boards(n);
+    Board solution;
+    for (int i = 0; i < n; i++) {
+        if (puzzledb_get(&db, (size_t)i, set.puzzles[set.count], solution))
+            set.count++;
+    }
+
+    puzzledb_close(&db);
+    return set;
+}
+
+static PuzzleSet load_lines(const char *name, const char *const *lines, int n)
+{
+    PuzzleSet set = { name, alloc_boards(n), 0 };
+    for (int i = 0; i < n; i++) {
+        if (board_from_line(set.puzzles[set.count], lines[i]))
+            set.count++;
+    }
+    return set;
+}
+
+// Relabels the digits of p so that its empty cells, in row-major order,
+// hold the highest values of the solution: the worst case for trying
+// values 1..9 in order.
+static void relabel_against_backtracking(Board p)
+{
+    Board sol;
+    memcpy(sol, p, sizeof(Board));
+    if (!solve_with(sol, SOLVER_MRV))
+        return;
+
+    int map[10] = {0};
+    int next = 9;
+    for (int cell = 0; cell < BOARD_LINE_LEN; cell++) {
+        int r = cell / BOARDSIZE, c = cell % BOARDSIZE;
+        if (p[r][c] == 0 && map[sol[r][c]] == 0)
+            map[sol[r][c]] = next--;
+    }
+    for (int v = 1; v <= 9; v++) {
+        if (map[v] == 0)
+            map[v] = next--;
+    }
+
+    for (int r = 0; r < BOARDSIZE; r++) {
+        for (int c = 0; c < BOARDSIZE; c++)
+            p[r][c] = map[p[r][c]];
+    }
+}
+
+static PuzzleSet make_adversarial(void)
+{
+    int n = (int)(sizeof(hard17) / sizeof(hard17[0]));
+    PuzzleSet set = { "adversarial", alloc_boards(n + 1), 0 };
+
+    board_from_line(set.puzzles[set.count++], anti_backtrack);
+    for (int i = 0; i < n; i++) {
+        if (board_from_line(set.puzzles[set.count], hard17[i])) {
+            relabel_against_backtracking(set.puzzles[set.count]);
+            set.count++;
+        }
+    }
+    return set;
+}
+
+static PuzzleSet make_generated(int n)
+{
+    PuzzleSet set = { "generated", alloc_boards(n), 0 };
+    GenRng rng;
+    gen_rng_seed(&rng, 12345); // fixed, so every build benches the same puzzles
+
+    Board solution;
+    for (int i = 0; i < n; i++)
+        generate_random_puzzle(set.puzzles[set.count++], solution, DIFFICULTY_HARD, 0, &rng);
+    return set;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static BenchResult run_engine(const PuzzleSet *set, const BenchEngine *e, double budget)
+{
+    BenchResult res = { set->name, e->name, 0, 0, 0, 0, 0, 0, 0, false };
+    uint64_t *lat = malloc((size_t)(set->count > 0 ? set->count : 1) * sizeof(uint64_t));
+    Board *work = alloc_boards(BATCH_LANES);
+    if (!lat) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    uint64_t budget_ns = (uint64_t)(budget * 1e9);
+    uint64_t start = time_now_ns();
+    int i = 0;
+
+    while (i < set->count) {
+        if (time_now_ns() - start > budget_ns) {
+            res.cut_short = true;
+            break;
+        }
+
+        if (e->engine == ENGINE_BATCH) {
+            // Latency per puzzle is the group's time split evenly
+            int n = set->count - i < BATCH_LANES ? set->count - i : BATCH_LANES;
+            memcpy(work, set->puzzles + i, (size_t)n * sizeof(Board));
+            solver_thread_stats.nodes = 0;
+
+            uint64_t t0 = time_now_ns();
+            res.solved += solve_batch(work, n, NULL);
+            uint64_t dt = time_now_ns() - t0;
+
+            res.nodes += solver_thread_stats.nodes;
+            for (int k = 0; k < n; k++)
+                lat[i + k] = dt / (uint64_t)n;
+            i += n;
+        } else {
+            SolverStats st;
+            memcpy(work[0], set->puzzles[i], sizeof(Board));
+
+            uint64_t t0 = time_now_ns();
+            res.solved += solve_with_stats(work[0], (SolverEngine)e->engine, &st);
+            lat[i] = time_now_ns() - t0;
+
+            res.nodes += st.nodes;
+            i++;
+        }
+    }
+
+    res.secs = (double)(time_now_ns() - start) / 1e9;
+    res.attempted = i;
+
+    if (i > 0) {
+        qsort(lat, (size_t)i, sizeof(uint64_t), cmp_u64);
+        res.p50_ns = lat[(i - 1) / 2];
+        res.p99_ns = lat[(int)((i - 1) * 0.99)];
+        res.max_ns = lat[i - 1];
+    }
+
+    free(lat);
+    free(work);
+    return res;
+}
+
+// Times n puzzles from the generator: generate_puzzle(), which picks from
+// the opened puzzle file as the server does, for "file", or a fresh
+// generate_random_puzzle() at d. Nodes are the uniqueness checks' search.
+static BenchResult run_generator(const char *level, Difficulty d, bool from_file,
+                                 int n, double budget)
+{
+    BenchResult res = { "generator", level, 0, 0, 0, 0, 0, 0, 0, false };
+    uint64_t *lat = malloc((size_t)(n > 0 ? n : 1) * sizeof(uint64_t));
+    if (!lat) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    GenRng rng;
+    gen_rng_seed(&rng, 12345);
+    Board puzzle, solution;
+    uint64_t budget_ns = (uint64_t)(budget * 1e9);
+    uint64_t start = time_now_ns();
+    int i = 0;
+
+    for (; i < n; i++) {
+        if (time_now_ns() - start > budget_ns) {
+            res.cut_short = true;
+            break;
+        }
+        solver_thread_stats.nodes = 0;
+
+        uint64_t t0 = time_now_ns();
+        if (from_file)
+            generate_puzzle(puzzle, solution);
+        else
+            generate_random_puzzle(puzzle, solution, d, 0, &rng);
+        lat[i] = time_now_ns() - t0;
+
+        res.nodes += solver_thread_stats.nodes;
+        res.solved++;
+    }
+
+    res.secs = (double)(time_now_ns() - start) / 1e9;
+    res.attempted = i;
+
+    if (i > 0) {
+        qsort(lat, (size_t)i, sizeof(uint64_t), cmp_u64);
+        res.p50_ns = lat[(i - 1) / 2];
+        res.p99_ns = lat[(int)((i - 1) * 0.99)];
+        res.max_ns = lat[i - 1];
+    }
+
+    free(lat);
+    return res;
+}
+
+static void print_result(const BenchResult *r)
+{
+    printf("%-12s %-10s %8d %8d %12.0f %10.1f %10.1f %10.1f %12.1f%s\n",
+           r->set, r->engine, r->attempted, r->solved,
+           r->secs > 0 ? r->attempted / r->secs : 0.0,
+           r->p50_ns / 1e3, r->p99_ns / 1e3, r->max_ns / 1e3,
+           r->attempted ? (double)r->nodes / r->attempted : 0.0,
+           r->cut_short ? "  (budget hit)" : "");
+}
+
+static void write_json(FILE *f, const BenchResult *results, int n)
+{
+    fprintf(f, "{\n  \"batch_kernel\": \"%s\",\n  \"results\": [\n", solve_batch_kernel());
+    for (int i = 0; i < n; i++) {
+        const BenchResult *r = &results[i];
+        fprintf(f,
+                "    {\"set\": \"%s\", \"engine\": \"%s\", \"puzzles\": %d, \"solved\": %d, "
+                "\"seconds\": %.6f, \"puzzles_per_sec\": %.1f, \"p50_ns\": %llu, "
+                "\"p99_ns\": %llu, \"max_ns\": %llu, \"nodes\": %llu, \"budget_hit\": %s}%s\n",
+                r->set, r->engine, r->attempted, r->solved, r->secs,
+                r->secs > 0 ? r->attempted / r->secs : 0.0,
+                (unsigned long long)r->p50_ns, (unsigned long long)r->p99_ns,
+                (unsigned long long)r->max_ns, (unsigned long long)r->nodes,
+                r->cut_short ? "true" : "false", i + 1 < n ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+}
+
+int main(int argc, char *argv[])
+{
+    const char *csv_path = "sudoku.csv";
+    const char *json_path = NULL;
+    const char *engine_list = NULL;
+    const char *set_list = NULL;
+    int limit = 0;
+    int generated = 200;
+    double budget = 10.0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        if (strcmp(a, "--csv") == 0 && i + 1 < argc) {
+            csv_path = argv[++i];
+        } else if (strcmp(a, "--limit") == 0 && i + 1 < argc) {
+            limit = atoi(argv[++i]);
+        } else if (strcmp(a, "--generated") == 0 && i + 1 < argc) {
+            generated = atoi(argv[++i]);
+        } else if (strcmp(a, "--budget") == 0 && i + 1 < argc) {
+            budget = atof(argv[++i]);
+        } else if (strcmp(a, "--engines") == 0 && i + 1 < argc) {
+            engine_list = argv[++i];
+        } else if (strcmp(a, "--sets") == 0 && i + 1 < argc) {
+            set_list = argv[++i];
+        } else if (strcmp(a, "--json") == 0 && i + 1 < argc) {
+            json_path = argv[++i];
+        } else {
+            fprintf(stderr,
+                    "Usage: %s [--csv PATH] [--limit N] [--generated N] [--budget SECONDS]\n"
+                    "          [--engines backtrack,dlx,mrv,batch]\n"
+                "          [--sets csv,hard17,adversarial,generated,generator]\n"
+                    "          [--json FILE|-]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    PuzzleSet sets[4];
+    int nsets = 0;
+    if (in_list(set_list, "csv"))
+        sets[nsets++] = load_csv(csv_path, limit);
+    if (in_list(set_list, "hard17"))
+        sets[nsets++] = load_lines("hard17", hard17, (int)(sizeof(hard17) / sizeof(hard17[0])));
+    if (in_list(set_list, "adversarial"))
+        sets[nsets++] = make_adversarial();
+    if (in_list(set_list, "generated") && generated > 0)
+        sets[nsets++] = make_generated(generated);
+
+    int nengines = (int)(sizeof(engines) / sizeof(engines[0]));
+    BenchResult *results = malloc((size_t)(nsets * nengines + 4) * sizeof(BenchResult));
+    int nresults = 0;
+    if (!results) {
+        perror("malloc");
+        return 1;
+    }
+
+    // Human-readable table on stdout unless the JSON goes there
+    bool table = !(json_path && strcmp(json_path, "-") == 0);
+    if (table)
+        printf("%-12s %-10s %8s %8s %12s %10s %10s %10s %12s\n",
+               "set", "engine", "puzzles", "solved", "puzzles/s",
+               "p50 us", "p99 us", "max us", "nodes/puzzle");
+
+    for (int s = 0; s < nsets; s++) {
+        if (sets[s].count == 0)
+            continue;
+        for (int e = 0; e < nengines; e++) {
+            if (!in_list(engine_list, engines[e].name))
+                continue;
+            results[nresults] = run_engine(&sets[s], &engines[e], budget);
+            if (table)
+                print_result(&results[nresults]);
+            nresults++;
+        }
+    }
+
+    if (in_list(set_list, "generator") && generated > 0) {
+        static const Difficulty levels[] = { DIFFICULTY_EASY, DIFFICULTY_MEDIUM, DIFFICULTY_HARD };
+
+        if (generator_open(csv_path)) {
+            results[nresults] = run_generator("file", DIFFICULTY_ANY, true, generated, budget);
+            if (table)
+                print_result(&results[nresults]);
+            nresults++;
+            generator_close();
+        }
+        for (size_t l = 0; l < sizeof(levels) / sizeof(levels[0]); l++) {
+            results[nresults] = run_generator(difficulty_name(levels[l]), levels[l], false,
+                                              generated, budget);
+            if (table)
+                print_result(&results[nresults]);
+            nresults++;
+        }
+    }
+
+    if (json_path) {
+        FILE *f = strcmp(json_path, "-") == 0 ? stdout : fopen(json_path, "w");
+        if (!f) {
+            fprintf(stderr, "Could not create %s\n", json_path);
+            return 1;
+        }
+        write_json(f, results, nresults);
+        if (f != stdout)
+            fclose(f);
+    }
+
+    for (int s = 0; s < nsets; s++)
+        free(sets[s].puzzles);
+    free(results);
+    return 0;
+}
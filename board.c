@@ -133,3 +133,22 @@ pos += (size_t)n;                                               \
 #undef APP
 }
 
+bool board_from_line(Board b, const char *line)
+{
+    for (int i = 0; i < BOARD_LINE_LEN; i++) {
+        char ch = line[i];
+        if (ch == '.')
+            ch = '0';
+        if (ch < '0' || ch > '9')
+            return false; // also stops at a premature '\0'
+        b[i / BOARDSIZE][i % BOARDSIZE] = ch - '0';
+    }
+    return true;
+}
+
+void board_to_line(const Board b, char *out)
+{
+    for (int i = 0; i < BOARD_LINE_LEN; i++)
+        out[i] = (char)('0' + b[i / BOARDSIZE][i % BOARDSIZE]);
+    out[BOARD_LINE_LEN] = '\0';
+}
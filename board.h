@@ -14,6 +14,13 @@ bool board_is_move_valid(const Board b, int r, int c, int v);
 bool board_is_full(const Board b);
 void board_to_string(const Board b, char *buf, size_t buf_size);
 
+#define BOARD_LINE_LEN (BOARDSIZE * BOARDSIZE)
+
+// 81 characters, row by row; '0' or '.' is an empty cell
+bool board_from_line(Board b, const char *line);
+// Writes the 81-character form plus a terminating '\0'
+void board_to_line(const Board b, char *out);
+
 
 #endif // BOARD_H
 
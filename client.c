@@ -0,0 +1,485 @@
+#include "client.h"
+#include "board.h"
+#include "game.h"
+#include "linebuf.h"
+#include "net.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <winsock2.h>
+    #define close closesocket
+    #define poll WSAPoll
+#else
+    #include <poll.h>
+    #include <unistd.h>
+    #include <sys/socket.h>
+#endif
+
+#define CLIENT_LINE_MAX  2048   // longest line the server sends
+#define CLIENT_INPUT_MAX 128    // longest line the player types
+
+// Where the connection is in the protocol
+typedef enum {
+    CLIENT_HELLO,       // HELLO sent, WELCOME not seen yet
+    CLIENT_LINES,       // text or delta lines
+    CLIENT_FRAMES       // binary frames
+} ClientState;
+
+// What a delta or binary client knows about the game, to render it locally
+typedef struct {
+    Board board;
+    int scores[2];
+    int turn;           // 1 or 2
+    bool in_menu;
+} ClientView;
+
+// One server message, whichever protocol it came in
+typedef struct {
+    ProtoMsgType type;
+    int a;              // player, seconds, cell (row * 9 + col) or ProtoNote
+    int b;              // value or score
+    Board board;        // MSG_PUZZLE
+} ClientEvent;
+
+typedef struct {
+    int fd;
+    ClientState state;
+    ProtoMode mode;             // what the server agreed to
+    LineBuf net;                // bytes from the server
+    LineBuf user;               // lines typed by the player
+    ClientView view;
+    ProtoMsgType awaiting;      // MSG_YOUR_MOVE / MSG_YOUR_MENU being answered, or 0
+} Client;
+
+static void client_print_board(const ClientView *v)
+{
+    char buf[GAME_RENDER_MAX];
+    board_to_string(v->board, buf, sizeof(buf));
+    printf("%s", buf);
+}
+
+// Player number, prompts and (in delta mode) game events; false for lines
+// that are only meant to be printed
+static bool client_parse_line(const Client *c, const char *line, ClientEvent *ev)
+{
+    char arg[BOARD_LINE_LEN + 1];     // a board line, or a note name
+    char row;
+    int a, b;
+
+    memset(ev, 0, sizeof(*ev));
+
+    if (sscanf(line, "YOU_ARE_PLAYER %d", &ev->a) == 1) {
+        ev->type = MSG_PLAYER;
+    } else if (strcmp(line, "YOUR_MOVE") == 0) {
+        ev->type = MSG_YOUR_MOVE;
+    } else if (strcmp(line, "YOUR_MENU") == 0) {
+        ev->type = MSG_YOUR_MENU;
+    } else if (c->mode != PROTO_DELTA) {
+        return false;
+    } else if (sscanf(line, "SPECTATING %d", &ev->a) == 1) {
+        ev->type = MSG_SPECTATING;
+    } else if (strcmp(line, "NO_GAME") == 0) {
+        ev->type = MSG_NO_GAME;
+    } else if (sscanf(line, "JOINED %d", &ev->a) == 1) {
+        ev->type = MSG_JOINED;
+    } else if (sscanf(line, "RULES %d", &ev->a) == 1) {
+        ev->type = MSG_RULES;
+    } else if (sscanf(line, "PUZZLE %81s", arg) == 1) {
+        if (!board_from_line(ev->board, arg))
+            return false;
+        ev->type = MSG_PUZZLE;
+    } else if (sscanf(line, "TURN %d", &ev->a) == 1) {
+        ev->type = MSG_TURN;
+    } else if (sscanf(line, "SET %c%d=%d", &row, &a, &b) == 3) {
+        if (row < 'A' || row > 'I' || a < 1 || a > BOARDSIZE)
+            return false;
+        ev->type = MSG_SET;
+        ev->a = (row - 'A') * BOARDSIZE + a - 1;
+        ev->b = b;
+    } else if (sscanf(line, "SCORE %d %d", &ev->a, &ev->b) == 2) {
+        ev->type = MSG_SCORE;
+    } else if (sscanf(line, "NOTE %31s", arg) == 1) {
+        ProtoNote note;
+        if (!proto_note_from_name(arg, &note))
+            return false;
+        ev->type = MSG_NOTE;
+        ev->a = note;
+    } else if (strcmp(line, "END") == 0) {
+        ev->type = MSG_END;
+    } else if (strcmp(line, "MENU") == 0) {
+        ev->type = MSG_MENU;
+    } else if (sscanf(line, "LEFT %d", &ev->a) == 1) {
+        ev->type = MSG_LEFT;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// false for frames this client does not know or that are too short
+static bool client_decode_frame(const uint8_t *frame, size_t size, ClientEvent *ev)
+{
+    const uint8_t *p = frame + PROTO_HEADER;
+    size_t len = size - PROTO_HEADER;
+
+    memset(ev, 0, sizeof(*ev));
+    ev->type = (ProtoMsgType)frame[0];
+
+    switch (ev->type) {
+    case MSG_PLAYER:
+    case MSG_JOINED:
+    case MSG_TURN:
+    case MSG_NOTE:
+    case MSG_LEFT:
+        if (len < 1)
+            return false;
+        ev->a = p[0];
+        return true;
+    case MSG_RULES:
+        if (len < 2)
+            return false;
+        ev->a = (p[0] << 8) | p[1];
+        return true;
+    case MSG_PUZZLE:
+        if (len < PROTO_BOARD_BYTES)
+            return false;
+        proto_unpack_board(p, ev->board);
+        return true;
+    case MSG_SET:
+        if (len < 2 || p[0] >= BOARD_LINE_LEN)
+            return false;
+        ev->a = p[0];
+        ev->b = p[1];
+        return true;
+    case MSG_SCORE:
+        if (len < 3)
+            return false;
+        ev->a = p[0];
+        ev->b = (p[1] << 8) | p[2];
+        return true;
+    case MSG_SPECTATING:
+        if (len < 4)
+            return false;
+        ev->a = (int)(((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | (p[2] << 8) | p[3]);
+        return true;
+    case MSG_END:
+    case MSG_MENU:
+    case MSG_YOUR_MOVE:
+    case MSG_YOUR_MENU:
+    case MSG_NO_GAME:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Updates the view and prints what the text protocol would have shown
+static void client_on_event(Client *c, const ClientEvent *ev)
+{
+    ClientView *v = &c->view;
+
+    // Prompts always come last in a server write, so anything after one
+    // means it has been answered or has timed out
+    c->awaiting = 0;
+
+    switch (ev->type) {
+    case MSG_PLAYER:
+        printf(">>> You are Player %d\n", ev->a);
+        break;
+    case MSG_SPECTATING:
+        printf(">>> Watching room %d\n", ev->a);
+        break;
+    case MSG_NO_GAME:
+        printf("No such game to watch.\n");
+        break;
+    case MSG_JOINED:
+        printf(PROTO_TEXT_JOINED, ev->a);
+        break;
+    case MSG_RULES:
+        printf(PROTO_TEXT_INTRO, ev->a);
+        break;
+    case MSG_PUZZLE:
+        memcpy(v->board, ev->board, sizeof(Board));
+        v->scores[0] = v->scores[1] = 0;
+        v->in_menu = false;
+        break;
+    case MSG_TURN:
+        v->turn = ev->a;
+        v->in_menu = false;
+        printf(PROTO_TEXT_TURN, ev->a, v->scores[0], v->scores[1]);
+        client_print_board(v);
+        break;
+    case MSG_SET:
+        v->board[ev->a / BOARDSIZE][ev->a % BOARDSIZE] = ev->b;
+        break;
+    case MSG_SCORE:
+        if (ev->a == 1 || ev->a == 2)
+            v->scores[ev->a - 1] = ev->b;
+        break;
+    case MSG_NOTE:
+        if (ev->a < NOTE_COUNT)
+            printf(proto_note_text((ProtoNote)ev->a), v->turn);
+        break;
+    case MSG_END:
+        printf(PROTO_TEXT_COMPLETE);
+        client_print_board(v);
+        printf(PROTO_TEXT_SCORES, v->scores[0], v->scores[1]);
+        printf("%s", proto_winner_text(v->scores[0], v->scores[1]));
+        break;
+    case MSG_MENU:
+        v->in_menu = true;
+        printf(PROTO_TEXT_MENU);
+        break;
+    case MSG_LEFT:
+        if (ev->a == 1 && v->in_menu)
+            printf(PROTO_TEXT_LEFT_MENU);
+        else
+            printf(PROTO_TEXT_LEFT, ev->a);
+        break;
+    case MSG_YOUR_MOVE:
+        c->awaiting = MSG_YOUR_MOVE;
+        printf("Enter move (A7 4): ");
+        break;
+    case MSG_YOUR_MENU:
+        c->awaiting = MSG_YOUR_MENU;
+        printf("MENU OPTIONS:\n");
+        printf("  R - Replay same puzzle\n");
+        printf("  N - Next puzzle\n");
+        printf("  Q - Quit game\n");
+        printf("Enter your choice (R/N/Q): ");
+        break;
+    default:
+        break;
+    }
+    fflush(stdout);
+}
+
+static void client_on_line(Client *c, const char *line)
+{
+    if (c->state == CLIENT_HELLO) {
+        ProtoMode mode;
+        if (strncmp(line, "WELCOME mode=", 13) == 0) {
+            char name[16];
+            c->mode = sscanf(line + 13, "%15s", name) == 1 &&
+                      proto_mode_from_name(name, &mode) ? mode : PROTO_TEXT;
+            c->state = c->mode == PROTO_BINARY ? CLIENT_FRAMES : CLIENT_LINES;
+            return;
+        }
+        // A server that does not know HELLO just starts talking text
+        c->mode = PROTO_TEXT;
+        c->state = CLIENT_LINES;
+    }
+
+    ClientEvent ev;
+    if (client_parse_line(c, line, &ev)) {
+        client_on_event(c, &ev);
+    } else {
+        c->awaiting = 0;
+        printf("%s\n", line);
+        fflush(stdout);
+    }
+}
+
+// Handles everything complete in c->net, switching from lines to frames
+// mid-buffer if WELCOME says so. False on a malformed frame.
+static bool client_drain(Client *c)
+{
+    for (;;) {
+        if (c->state == CLIENT_FRAMES) {
+            size_t avail;
+            const uint8_t *buf = (const uint8_t *)linebuf_peek(&c->net, &avail);
+            long size = proto_frame_size(buf, avail);
+            if (size <= 0)
+                return size == 0;
+
+            ClientEvent ev;
+            if (client_decode_frame(buf, (size_t)size, &ev))
+                client_on_event(c, &ev);
+            linebuf_consume(&c->net, (size_t)size);
+        } else {
+            char *line = linebuf_next(&c->net, NULL);
+            if (!line)
+                return true;
+            client_on_line(c, line);
+        }
+    }
+}
+
+static bool client_send(Client *c, const void *data, size_t len)
+{
+    const char *p = data;
+    while (len > 0) {
+        long n = (long)send(c->fd, p, (int)len, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            perror("send");
+            return false;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+// Answers the outstanding prompt with what the player typed
+static bool client_answer(Client *c, const char *input)
+{
+    ProtoMsgType prompt = c->awaiting;
+    c->awaiting = 0;
+
+    if (c->state != CLIENT_FRAMES) {
+        char buf[CLIENT_INPUT_MAX + 2];
+        int len = snprintf(buf, sizeof(buf), "%s\n", input);
+        return client_send(c, buf, (size_t)len);
+    }
+
+    // Input the server would reject as badly formatted goes out as an
+    // impossible move or an empty choice, so the outcome is the same
+    uint8_t frame[PROTO_HEADER + 2];
+    size_t size;
+    if (prompt == MSG_YOUR_MOVE) {
+        int r, col, v;
+        uint8_t move[2] = { 0xFF, 0 };
+        if (proto_parse_move(input, &r, &col, &v)) {
+            move[0] = (uint8_t)(r * BOARDSIZE + col);
+            move[1] = (uint8_t)v;
+        }
+        size = proto_encode(frame, MSG_MOVE, move, sizeof(move));
+    } else {
+        uint8_t choice;
+        bool empty = sscanf(input, " %c", (char *)&choice) != 1;
+        size = proto_encode(frame, MSG_CHOICE, &choice, empty ? 0 : 1);
+    }
+    return client_send(c, frame, size);
+}
+
+int run_client(const ClientOptions *opt)
+{
+    // Old servers never answer HELLO, so plain text players without a
+    // preference still skip it
+    bool hello = opt->mode != PROTO_TEXT || opt->difficulty != DIFFICULTY_ANY ||
+                 opt->spectate || opt->turn_seconds > 0;
+    Client c = {
+        .state = hello ? CLIENT_HELLO : CLIENT_LINES,
+        .mode = PROTO_TEXT,
+        .view = { .turn = 1 },
+    };
+    int result = 0;
+
+    if (opt->player_id > 0)
+        printf("CLIENT %d connecting...\n", opt->player_id);
+    else
+        printf("CLIENT connecting...\n");
+
+    c.fd = net_connect(opt->host, opt->port);
+    if (c.fd < 0)
+        return 1;
+
+    printf("Connected to server.\n");
+
+    if (!linebuf_init(&c.net, CLIENT_LINE_MAX) || !linebuf_init(&c.user, CLIENT_INPUT_MAX)) {
+        linebuf_free(&c.net);
+        close(c.fd);
+        return 1;
+    }
+
+    if (hello) {
+        char extra[64] = "";
+        if (opt->spectate && opt->room > 0)
+            snprintf(extra, sizeof(extra), " role=spectate room=%d", opt->room);
+        else if (opt->spectate)
+            snprintf(extra, sizeof(extra), " role=spectate");
+        else if (opt->turn_seconds > 0)
+            snprintf(extra, sizeof(extra), " turn=%d", opt->turn_seconds);
+
+        char line[128];
+        int len = snprintf(line, sizeof(line), "HELLO mode=%s version=%d difficulty=%s%s\n",
+                           proto_mode_name(opt->mode), PROTO_VERSION,
+                           difficulty_name(opt->difficulty), extra);
+        if (!client_send(&c, line, (size_t)len))
+            result = 1;
+    }
+
+    while (result == 0) {
+        // Lines typed ahead answer the next prompt, as they did when the
+        // client read the keyboard only when asked
+        char *input;
+        if (c.awaiting && (input = linebuf_next(&c.user, NULL)) != NULL) {
+            if (!client_answer(&c, input)) {
+                result = 1;
+                break;
+            }
+            continue;
+        }
+
+#ifdef _WIN32
+        // WSAPoll() only takes sockets, so the console is read blocking,
+        // and only while a prompt is up
+        if (c.awaiting) {
+            char line[CLIENT_INPUT_MAX];
+            if (!fgets(line, sizeof(line), stdin)) {
+                printf("\nInput closed. Exiting.\n");
+                break;
+            }
+            line[strcspn(line, "\n")] = '\0';
+            if (!client_answer(&c, line)) {
+                result = 1;
+                break;
+            }
+            continue;
+        }
+        struct pollfd fds[1] = { { (SOCKET)c.fd, POLLIN, 0 } };
+        int nfds = 1;
+#else
+        struct pollfd fds[2] = {
+            { c.fd, POLLIN, 0 },
+            { STDIN_FILENO, POLLIN, 0 },
+        };
+        int nfds = c.awaiting ? 2 : 1;
+#endif
+
+        if (poll(fds, nfds, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("poll");
+            result = 1;
+            break;
+        }
+
+        if (fds[0].revents) {
+            long n = linebuf_fill(&c.net, c.fd);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0) {
+                printf("\nServer closed connection.\n");
+                break;
+            }
+            if (!client_drain(&c)) {
+                fprintf(stderr, "Malformed message from server.\n");
+                result = 1;
+                break;
+            }
+        }
+
+#ifndef _WIN32
+        if (nfds > 1 && fds[1].revents) {
+            long n = linebuf_read(&c.user, STDIN_FILENO);
+            if (n == 0 || (n < 0 && errno != EINTR)) {
+                printf("\nInput closed. Exiting.\n");
+                break;
+            }
+        }
+#endif
+    }
+
+    linebuf_free(&c.user);
+    linebuf_free(&c.net);
+    close(c.fd);
+    return result;
+}
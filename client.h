@@ -0,0 +1,27 @@
+#ifndef CLIENT_H
+#define CLIENT_H
+
+#include "generator.h"
+#include "proto.h"
+
+#include <stdbool.h>
+
+typedef struct {
+    int player_id;          // labels the output only, 0 = none
+    const char *host;
+    int port;
+    ProtoMode mode;         // asked for in HELLO; the server may pick another
+    Difficulty difficulty;  // level to be matched on
+    int turn_seconds;       // turn length for a room this player opens, 0 = server's
+    bool spectate;          // watch a game instead of playing
+    int room;               // game to watch, 0 = the newest
+} ClientOptions;
+
+// Plays one seat against a server, or watches a game. The socket and the
+// keyboard are watched together, so server messages are shown as they
+// arrive even while the player is typing, and the keyboard is only read
+// once a move or menu choice is asked for. The server seats players as
+// they are paired.
+int run_client(const ClientOptions *opt);
+
+#endif //CLIENT_H
@@ -0,0 +1,184 @@
+#include "dlx.h"
+#include "solver.h"
+
+#define ROOT 0
+
+// Header node of constraint column c (1-based, 0 is the root)
+#define HEADER(c) ((int16_t)((c) + 1))
+
+static void cover(DlxSolver *d, int c)
+{
+    d->right[d->left[c]] = d->right[c];
+    d->left[d->right[c]] = d->left[c];
+
+    for (int i = d->down[c]; i != c; i = d->down[i]) {
+        for (int j = d->right[i]; j != i; j = d->right[j]) {
+            d->down[d->up[j]] = d->down[j];
+            d->up[d->down[j]] = d->up[j];
+            d->size[d->column[j]]--;
+        }
+    }
+}
+
+static void uncover(DlxSolver *d, int c)
+{
+    for (int i = d->up[c]; i != c; i = d->up[i]) {
+        for (int j = d->left[i]; j != i; j = d->left[j]) {
+            d->size[d->column[j]]++;
+            d->down[d->up[j]] = (int16_t)j;
+            d->up[d->down[j]] = (int16_t)j;
+        }
+    }
+
+    d->right[d->left[c]] = (int16_t)c;
+    d->left[d->right[c]] = (int16_t)c;
+}
+
+// Covers every other column of the row that node r belongs to
+static void select_row(DlxSolver *d, int r)
+{
+    for (int j = d->right[r]; j != r; j = d->right[j])
+        cover(d, d->column[j]);
+}
+
+static void unselect_row(DlxSolver *d, int r)
+{
+    for (int j = d->left[r]; j != r; j = d->left[j])
+        uncover(d, d->column[j]);
+}
+
+void dlx_init(DlxSolver *d)
+{
+    // Root and column headers form one circular list
+    for (int i = 0; i <= DLX_COLUMNS; i++) {
+        d->left[i]   = (int16_t)(i == 0 ? DLX_COLUMNS : i - 1);
+        d->right[i]  = (int16_t)(i == DLX_COLUMNS ? 0 : i + 1);
+        d->up[i]     = (int16_t)i;
+        d->down[i]   = (int16_t)i;
+        d->column[i] = (int16_t)i;
+        d->row[i]    = -1;
+        d->size[i]   = 0;
+    }
+
+    int node = DLX_COLUMNS + 1;
+    for (int cand = 0; cand < DLX_ROWS; cand++) {
+        int cell = cand / 9;
+        int digit = cand % 9;
+        int cols[4] = {
+            cell,
+            81  + solver_cell_row[cell] * 9 + digit,
+            162 + solver_cell_col[cell] * 9 + digit,
+            243 + solver_cell_box[cell] * 9 + digit
+        };
+
+        int first = node;
+        d->row_head[cand] = (int16_t)first;
+
+        for (int k = 0; k < 4; k++, node++) {
+            int16_t h = HEADER(cols[k]);
+
+            d->column[node] = h;
+            d->row[node]    = (int16_t)cand;
+
+            // Append at the bottom of the column
+            d->up[node]      = d->up[h];
+            d->down[node]    = h;
+            d->down[d->up[h]] = (int16_t)node;
+            d->up[h]         = (int16_t)node;
+            d->size[h]++;
+
+            d->left[node]  = (int16_t)(k == 0 ? first + 3 : node - 1);
+            d->right[node] = (int16_t)(k == 3 ? first : node + 1);
+        }
+    }
+
+    d->ready = true;
+}
+
+// Column with the fewest remaining rows, or -1 once everything is covered
+static int choose_column(const DlxSolver *d)
+{
+    int best = -1;
+    int best_size = DLX_ROWS + 1;
+
+    for (int c = d->right[ROOT]; c != ROOT; c = d->right[c]) {
+        if (d->size[c] < best_size) {
+            best = c;
+            best_size = d->size[c];
+            if (best_size <= 1)
+                break;
+        }
+    }
+    return best;
+}
+
+static int search(DlxSolver *d, int depth)
+{
+    SOLVER_STAT_ADD(nodes, 1);
+    SOLVER_STAT_DEPTH(depth);
+
+    int c = choose_column(d);
+    if (c < 0)
+        return depth; // exact cover found
+
+    if (d->size[c] == 0)
+        return -1;
+
+    int found = -1;
+    cover(d, c);
+
+    for (int r = d->down[c]; r != c && found < 0; r = d->down[r]) {
+        d->picked[depth] = d->row[r];
+        SOLVER_TRACE(depth, "try", d->row[r] / 9, d->row[r] % 9 + 1);
+        select_row(d, r);
+        found = search(d, depth + 1);
+        unselect_row(d, r);
+        if (found < 0)
+            SOLVER_STAT_ADD(backtracks, 1);
+    }
+
+    uncover(d, c);
+    return found;
+}
+
+int dlx_solve(DlxSolver *d, Board b)
+{
+    SolverState s;
+    if (!solver_state_init(&s, b))
+        return 0;
+
+    if (!d->ready)
+        dlx_init(d);
+
+    // Givens are forced rows: take them out of the matrix before searching
+    int given[SOLVER_CELLS];
+    int ngiven = 0;
+
+    for (int cell = 0; cell < SOLVER_CELLS; cell++) {
+        if (s.cells[cell] == 0)
+            continue;
+        int r = d->row_head[cell * 9 + s.cells[cell] - 1];
+        cover(d, d->column[r]);
+        select_row(d, r);
+        given[ngiven++] = r;
+    }
+
+    int depth = search(d, 0);
+
+    for (int i = 0; i < depth; i++) {
+        int cand = d->picked[i];
+        s.cells[cand / 9] = (uint8_t)(cand % 9 + 1);
+    }
+
+    // Restore the matrix for the next solve
+    for (int i = ngiven - 1; i >= 0; i--) {
+        unselect_row(d, given[i]);
+        uncover(d, d->column[given[i]]);
+    }
+
+    if (depth < 0)
+        return 0;
+
+    solver_state_to_board(&s, b);
+    return 1;
+}
@@ -0,0 +1,34 @@
+#ifndef DLX_H
+#define DLX_H
+
+#include "board.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Exact cover matrix for a 9x9 Sudoku: 324 constraint columns
+// (cell, row-digit, col-digit, box-digit) and 729 candidate rows.
+#define DLX_COLUMNS 324
+#define DLX_ROWS    729
+#define DLX_NODES   (1 + DLX_COLUMNS + DLX_ROWS * 4)
+
+// All links live in fixed arrays, so a DlxSolver can be set up once and
+// reused: every solve uncovers what it covered and leaves the matrix intact.
+typedef struct {
+    int16_t left[DLX_NODES];
+    int16_t right[DLX_NODES];
+    int16_t up[DLX_NODES];
+    int16_t down[DLX_NODES];
+    int16_t column[DLX_NODES];
+    int16_t row[DLX_NODES];          // candidate id cell * 9 + (value - 1)
+    int16_t size[DLX_COLUMNS + 1];
+    int16_t row_head[DLX_ROWS];      // first node of each candidate row
+    int16_t picked[DLX_ROWS];        // search stack of chosen candidate rows
+    bool    ready;
+} DlxSolver;
+
+void dlx_init(DlxSolver *d);
+
+// Solves b in place. Returns 1 on success, 0 if the puzzle has no solution.
+int dlx_solve(DlxSolver *d, Board b);
+
+#endif //DLX_H
@@ -0,0 +1,206 @@
+#include "evloop.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__)
+    #define EVLOOP_EPOLL 1
+    #include <sys/epoll.h>
+    #include <unistd.h>
+#elif defined(_WIN32)
+    #include <winsock2.h>
+    #define poll WSAPoll
+#else
+    #include <poll.h>
+#endif
+
+#ifdef EVLOOP_EPOLL
+
+struct EvLoop {
+    int epfd;
+    struct epoll_event *events;
+    int cap;
+};
+
+static uint32_t to_epoll(unsigned events)
+{
+    uint32_t e = EPOLLRDHUP;
+    if (events & EV_READ)
+        e |= EPOLLIN;
+    if (events & EV_WRITE)
+        e |= EPOLLOUT;
+    return e;
+}
+
+EvLoop *evloop_create(void)
+{
+    EvLoop *loop = calloc(1, sizeof(*loop));
+    if (!loop)
+        return NULL;
+
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epfd < 0) {
+        free(loop);
+        return NULL;
+    }
+    return loop;
+}
+
+void evloop_destroy(EvLoop *loop)
+{
+    if (!loop)
+        return;
+    close(loop->epfd);
+    free(loop->events);
+    free(loop);
+}
+
+int evloop_add(EvLoop *loop, int fd, unsigned events, void *data)
+{
+    struct epoll_event ev = { .events = to_epoll(events), .data.ptr = data };
+    return epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+int evloop_mod(EvLoop *loop, int fd, unsigned events, void *data)
+{
+    struct epoll_event ev = { .events = to_epoll(events), .data.ptr = data };
+    return epoll_ctl(loop->epfd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+int evloop_del(EvLoop *loop, int fd)
+{
+    return epoll_ctl(loop->epfd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+int evloop_wait(EvLoop *loop, EvEvent *out, int max, int timeout_ms)
+{
+    if (max > loop->cap) {
+        struct epoll_event *grown = realloc(loop->events, (size_t)max * sizeof(*grown));
+        if (!grown)
+            return -1;
+        loop->events = grown;
+        loop->cap = max;
+    }
+
+    int n = epoll_wait(loop->epfd, loop->events, max, timeout_ms);
+    if (n < 0)
+        return errno == EINTR ? 0 : -1;
+
+    for (int i = 0; i < n; i++) {
+        uint32_t e = loop->events[i].events;
+        out[i].data = loop->events[i].data.ptr;
+        out[i].events = ((e & EPOLLIN) ? EV_READ : 0) |
+                        ((e & EPOLLOUT) ? EV_WRITE : 0) |
+                        ((e & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) ? EV_ERROR : 0);
+    }
+    return n;
+}
+
+#else // poll()
+
+struct EvLoop {
+    struct pollfd *fds;
+    void **data;
+    int count;
+    int cap;
+};
+
+static short to_poll(unsigned events)
+{
+    short e = 0;
+    if (events & EV_READ)
+        e |= POLLIN;
+    if (events & EV_WRITE)
+        e |= POLLOUT;
+    return e;
+}
+
+static int find_fd(const EvLoop *loop, int fd)
+{
+    for (int i = 0; i < loop->count; i++) {
+        if ((int)loop->fds[i].fd == fd)
+            return i;
+    }
+    return -1;
+}
+
+EvLoop *evloop_create(void)
+{
+    return calloc(1, sizeof(EvLoop));
+}
+
+void evloop_destroy(EvLoop *loop)
+{
+    if (!loop)
+        return;
+    free(loop->fds);
+    free(loop->data);
+    free(loop);
+}
+
+int evloop_add(EvLoop *loop, int fd, unsigned events, void *data)
+{
+    if (loop->count == loop->cap) {
+        int cap = loop->cap ? loop->cap * 2 : 64;
+        struct pollfd *fds = realloc(loop->fds, (size_t)cap * sizeof(*fds));
+        if (!fds)
+            return -1;
+        loop->fds = fds;
+        void **d = realloc(loop->data, (size_t)cap * sizeof(*d));
+        if (!d)
+            return -1;
+        loop->data = d;
+        loop->cap = cap;
+    }
+
+    loop->fds[loop->count].fd = fd;
+    loop->fds[loop->count].events = to_poll(events);
+    loop->fds[loop->count].revents = 0;
+    loop->data[loop->count] = data;
+    loop->count++;
+    return 0;
+}
+
+int evloop_mod(EvLoop *loop, int fd, unsigned events, void *data)
+{
+    int i = find_fd(loop, fd);
+    if (i < 0)
+        return -1;
+    loop->fds[i].events = to_poll(events);
+    loop->data[i] = data;
+    return 0;
+}
+
+int evloop_del(EvLoop *loop, int fd)
+{
+    int i = find_fd(loop, fd);
+    if (i < 0)
+        return -1;
+    loop->count--;
+    loop->fds[i] = loop->fds[loop->count];
+    loop->data[i] = loop->data[loop->count];
+    return 0;
+}
+
+int evloop_wait(EvLoop *loop, EvEvent *out, int max, int timeout_ms)
+{
+    int ready = poll(loop->fds, (unsigned)loop->count, timeout_ms);
+    if (ready < 0)
+        return errno == EINTR ? 0 : -1;
+
+    int n = 0;
+    for (int i = 0; i < loop->count && n < max; i++) {
+        short e = loop->fds[i].revents;
+        if (!e)
+            continue;
+        out[n].data = loop->data[i];
+        out[n].events = ((e & POLLIN) ? EV_READ : 0) |
+                        ((e & POLLOUT) ? EV_WRITE : 0) |
+                        ((e & (POLLERR | POLLHUP | POLLNVAL)) ? EV_ERROR : 0);
+        n++;
+    }
+    return n;
+}
+
+#endif // EVLOOP_EPOLL
@@ -0,0 +1,30 @@
+#ifndef EVLOOP_H
+#define EVLOOP_H
+
+// Readiness notification for many sockets: epoll on Linux, poll()
+// everywhere else. Each registered fd carries an opaque pointer that comes
+// back with its events.
+
+#define EV_READ  1u
+#define EV_WRITE 2u
+#define EV_ERROR 4u     // hang-up or socket error, always reported
+
+typedef struct {
+    void *data;
+    unsigned events;
+} EvEvent;
+
+typedef struct EvLoop EvLoop;
+
+EvLoop *evloop_create(void);
+void evloop_destroy(EvLoop *loop);
+
+int evloop_add(EvLoop *loop, int fd, unsigned events, void *data);
+int evloop_mod(EvLoop *loop, int fd, unsigned events, void *data);
+int evloop_del(EvLoop *loop, int fd);
+
+// Waits up to timeout_ms (-1 = forever). Returns the number of events
+// stored in out, 0 on timeout, -1 on error.
+int evloop_wait(EvLoop *loop, EvEvent *out, int max, int timeout_ms);
+
+#endif //EVLOOP_H
@@ -0,0 +1,135 @@
+#include "game.h"
+#include "solver.h"
+
+#include <string.h>
+
+static void set_cell(GameState *g, int cell, int value)
+{
+    uint16_t bit = (uint16_t)(1u << (value - 1));
+    g->cells[cell] = (uint8_t)value;
+    g->rows[solver_cell_row[cell]]  |= bit;
+    g->cols[solver_cell_col[cell]]  |= bit;
+    g->boxes[solver_cell_box[cell]] |= bit;
+    g->filled++;
+}
+
+void game_init(GameState *g, const Board puzzle, const Board solution)
+{
+    memset(g, 0, sizeof(*g));
+
+    for (int cell = 0; cell < GAME_CELLS; cell++) {
+        int r = cell / BOARDSIZE;
+        int c = cell % BOARDSIZE;
+
+        g->solution[cell / 2] |= (uint8_t)((solution[r][c] & 0xF) << (4 * (cell & 1)));
+
+        if (puzzle[r][c] != 0) {
+            g->givens[cell / 64] |= 1ull << (cell % 64);
+            set_cell(g, cell, puzzle[r][c]);
+        }
+    }
+}
+
+bool game_is_given(const GameState *g, int row, int col)
+{
+    int cell = row * BOARDSIZE + col;
+    return (g->givens[cell / 64] >> (cell % 64)) & 1u;
+}
+
+int game_solution_at(const GameState *g, int row, int col)
+{
+    int cell = row * BOARDSIZE + col;
+    return (g->solution[cell / 2] >> (4 * (cell & 1))) & 0xF;
+}
+
+void game_reset(GameState *g)
+{
+    memset(g->rows, 0, sizeof(g->rows));
+    memset(g->cols, 0, sizeof(g->cols));
+    memset(g->boxes, 0, sizeof(g->boxes));
+    g->filled = 0;
+
+    for (int cell = 0; cell < GAME_CELLS; cell++) {
+        int v = g->cells[cell];
+        g->cells[cell] = 0;
+        if (v && ((g->givens[cell / 64] >> (cell % 64)) & 1u))
+            set_cell(g, cell, v);
+    }
+}
+
+MoveStatus game_validate_move(const GameState *g, int row, int col, int value)
+{
+    if (row < 0 || row >= BOARDSIZE || col < 0 || col >= BOARDSIZE ||
+        value < 1 || value > 9) {
+        return MOVE_OUT_OF_RANGE;
+    }
+
+    if (game_is_given(g, row, col))
+        return MOVE_FIXED_CELL;
+
+    int cell = row * BOARDSIZE + col;
+    if (g->cells[cell] != 0)
+        return MOVE_ALREADY_FILLED;
+
+    uint16_t used = g->rows[row] | g->cols[col] | g->boxes[solver_cell_box[cell]];
+    if (used & (1u << (value - 1)))
+        return MOVE_BREAKS_RULES;
+
+    return MOVE_OK;
+}
+
+void game_place(GameState *g, int row, int col, int value)
+{
+    set_cell(g, row * BOARDSIZE + col, value);
+}
+
+void game_to_board(const GameState *g, Board b)
+{
+    for (int cell = 0; cell < GAME_CELLS; cell++)
+        b[cell / BOARDSIZE][cell % BOARDSIZE] = g->cells[cell];
+}
+
+size_t game_render(const GameState *g, char *buf, size_t buf_size)
+{
+    static const char header[] = "\n    1 2 3   4 5 6   7 8 9   \n";
+    static const char rule[]   = "+-------+-------+-------+\n";
+
+    char out[GAME_RENDER_MAX];
+    size_t pos = 0;
+
+    memcpy(out + pos, header, sizeof(header) - 1);
+    pos += sizeof(header) - 1;
+    memcpy(out + pos, rule, sizeof(rule) - 1);
+    pos += sizeof(rule) - 1;
+
+    for (int r = 0; r < BOARDSIZE; r++) {
+        out[pos++] = (char)('A' + r);
+        out[pos++] = ' ';
+        out[pos++] = '|';
+        out[pos++] = ' ';
+
+        for (int c = 0; c < BOARDSIZE; c++) {
+            int v = g->cells[r * BOARDSIZE + c];
+            out[pos++] = v ? (char)('0' + v) : ' ';
+            out[pos++] = ' ';
+            if ((c + 1) % 3 == 0) {
+                out[pos++] = '|';
+                out[pos++] = ' ';
+            }
+        }
+        out[pos++] = '\n';
+
+        if ((r + 1) % 3 == 0) {
+            memcpy(out + pos, rule, sizeof(rule) - 1);
+            pos += sizeof(rule) - 1;
+        }
+    }
+
+    if (buf_size == 0)
+        return 0;
+    if (pos >= buf_size)
+        pos = buf_size - 1;
+    memcpy(buf, out, pos);
+    buf[pos] = '\0';
+    return pos;
+}
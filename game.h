@@ -0,0 +1,57 @@
+#ifndef GAME_H
+#define GAME_H
+
+#include "board.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define GAME_CELLS (BOARDSIZE * BOARDSIZE)
+
+// Longest game_render() output, including the terminating '\0'
+#define GAME_RENDER_MAX 400
+
+typedef enum {
+    MOVE_OK,
+    MOVE_OUT_OF_RANGE,
+    MOVE_FIXED_CELL,
+    MOVE_ALREADY_FILLED,
+    MOVE_BREAKS_RULES
+} MoveStatus;
+
+// Everything one game needs, in about 200 bytes instead of three or four
+// int Boards (324 bytes each). The puzzle itself is the cells flagged in
+// `givens`; rows/cols/boxes mirror the cells as 9-bit occupancy masks so
+// rule checks are a single AND. Plain struct: copy by assignment.
+typedef struct {
+    uint8_t  cells[GAME_CELLS];           // current values, 0 = empty
+    uint8_t  solution[(GAME_CELLS + 1) / 2]; // two cells per byte
+    uint8_t  filled;                      // non-empty cells
+    uint64_t givens[2];                   // bit i: cell i is an original clue
+    uint16_t rows[BOARDSIZE];
+    uint16_t cols[BOARDSIZE];
+    uint16_t boxes[BOARDSIZE];
+} GameState;
+
+void game_init(GameState *g, const Board puzzle, const Board solution);
+
+// Back to the original clues, for replaying the same puzzle
+void game_reset(GameState *g);
+
+MoveStatus game_validate_move(const GameState *g, int row, int col, int value);
+void game_place(GameState *g, int row, int col, int value);
+
+int game_solution_at(const GameState *g, int row, int col);
+bool game_is_given(const GameState *g, int row, int col);
+
+static inline bool game_is_full(const GameState *g)
+{
+    return g->filled == GAME_CELLS;
+}
+
+void game_to_board(const GameState *g, Board b);
+
+// Same text as board_to_string(), written directly from the cells
+size_t game_render(const GameState *g, char *buf, size_t buf_size);
+
+#endif //GAME_H
@@ -4,71 +4,170 @@
 #include <string.h>
 #include <time.h>
 #include "board.h"
+#include "solver.h"
+#include "puzzledb.h"
 
-void generate_puzzle(Board puzzle, Board solution) {
-    FILE *f = fopen("sudoku.csv", "r");
-    if (!f) {
-        fprintf(stderr, "Could not open sudoku.csv\n");
-        exit(1);
-    }
+// Most removal passes bottom out around 22-26 clues
+#define HARD_ATTEMPTS 16
+
+// Puzzle file used by generate_puzzle(), mapped once
+static PuzzleDb g_db;
+static bool g_db_open;
+// generate_puzzle() may run on the server thread and the prefetch thread
+static _Thread_local GenRng g_rng;
+
+static const char *const difficulty_names[] = {
+    [DIFFICULTY_ANY]    = "any",
+    [DIFFICULTY_EASY]   = "easy",
+    [DIFFICULTY_MEDIUM] = "medium",
+    [DIFFICULTY_HARD]   = "hard"
+};
 
-    char line[256];
+static const int difficulty_clues[] = {
+    [DIFFICULTY_ANY]    = 30,
+    [DIFFICULTY_EASY]   = 36,
+    [DIFFICULTY_MEDIUM] = 30,
+    [DIFFICULTY_HARD]   = 17
+};
 
-    // Skip header
-    if (!fgets(line, sizeof(line), f)) {
-        fprintf(stderr, "Empty sudoku.csv\n");
-        exit(1);
+const char *difficulty_name(Difficulty d)
+{
+    if ((unsigned)d >= sizeof(difficulty_names) / sizeof(difficulty_names[0]))
+        return "unknown";
+    return difficulty_names[d];
+}
+
+bool difficulty_from_name(const char *name, Difficulty *out)
+{
+    for (size_t i = 0; i < sizeof(difficulty_names) / sizeof(difficulty_names[0]); i++) {
+        if (strcmp(name, difficulty_names[i]) == 0) {
+            *out = (Difficulty)i;
+            return true;
+        }
     }
+    return false;
+}
 
-    // Count how many puzzle lines there are (excluding header)
-    long count = 0;
-    long pos_after_header = ftell(f);  // remember after header
-    while (fgets(line, sizeof(line), f)) {
-        count++;
+void gen_rng_seed(GenRng *rng, uint64_t seed)
+{
+    // splitmix64 step, so nearby seeds give unrelated streams
+    uint64_t z = seed + 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    z ^= z >> 31;
+    rng->state = z ? z : 1;
+}
+
+static uint64_t gen_rng_next(GenRng *rng)
+{
+    uint64_t x = rng->state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    rng->state = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+uint32_t gen_rng_below(GenRng *rng, uint32_t n)
+{
+    return (uint32_t)(((gen_rng_next(rng) >> 32) * (uint64_t)n) >> 32);
+}
+
+static void shuffle(uint8_t *a, int n, GenRng *rng)
+{
+    for (int i = n - 1; i > 0; i--) {
+        int j = (int)gen_rng_below(rng, (uint32_t)i + 1);
+        uint8_t t = a[i];
+        a[i] = a[j];
+        a[j] = t;
     }
+}
 
-    if (count == 0) {
-        fprintf(stderr, "No puzzles found in sudoku.csv\n");
-        exit(1);
+void generate_solution(Board solution, GenRng *rng)
+{
+    // The three diagonal boxes share no row, column or box, so any
+    // permutation of 1..9 in each is consistent; the solver completes the rest.
+    board_init(solution);
+
+    for (int box = 0; box < 3; box++) {
+        uint8_t digits[BOARDSIZE] = {1, 2, 3, 4, 5, 6, 7, 8, 9};
+        shuffle(digits, BOARDSIZE, rng);
+        for (int i = 0; i < BOARDSIZE; i++)
+            solution[box * 3 + i / 3][box * 3 + i % 3] = digits[i];
     }
 
-    // Pick a random puzzle line
-    srand((unsigned) time(NULL));
-    long target = rand() % count;
+    solve_board_mrv(solution);
+}
 
-    // Go back to the line after the header
-    fseek(f, pos_after_header, SEEK_SET);
+// Empties cells in random order while the puzzle stays unique (and, for
+// easy/medium, solvable by singles). Returns the number of clues left.
+static int remove_clues(Board puzzle, Difficulty d, int target, GenRng *rng)
+{
+    uint8_t order[BOARD_LINE_LEN];
+    for (int i = 0; i < BOARD_LINE_LEN; i++)
+        order[i] = (uint8_t)i;
+    shuffle(order, BOARD_LINE_LEN, rng);
 
-    // Skip until we reach the chosen puzzle line
-    for (long i = 0; i < target; i++) {
-        if (!fgets(line, sizeof(line), f)) {
-            fprintf(stderr, "Unexpected EOF in sudoku.csv\n");
-            exit(1);
-        }
-    }
+    int clues = BOARD_LINE_LEN;
+    bool singles = d == DIFFICULTY_EASY || d == DIFFICULTY_MEDIUM;
+
+    for (int i = 0; i < BOARD_LINE_LEN && clues > target; i++) {
+        int r = order[i] / BOARDSIZE;
+        int c = order[i] % BOARDSIZE;
+        int v = puzzle[r][c];
 
-    // Read the selected puzzle line
-    if (!fgets(line, sizeof(line), f)) {
-        fprintf(stderr, "Failed to read selected puzzle\n");
-        exit(1);
+        puzzle[r][c] = 0;
+        if (count_solutions(puzzle, 2) != 1 || (singles && !solve_singles(puzzle)))
+            puzzle[r][c] = v;
+        else
+            clues--;
     }
+    return clues;
+}
 
+void generate_random_puzzle(Board puzzle, Board solution, Difficulty d,
+                            int target_clues, GenRng *rng)
+{
+    int target = target_clues > 0 ? target_clues : difficulty_clues[d];
+    int attempts = d == DIFFICULTY_HARD ? HARD_ATTEMPTS : 1;
 
-    char *quiz = strtok(line, ",");
-    char *sol  = strtok(NULL, ",\n\r");
+    for (int attempt = 0; attempt < attempts; attempt++) {
+        generate_solution(solution, rng);
+        memcpy(puzzle, solution, sizeof(Board));
+        remove_clues(puzzle, d, target, rng);
 
-    if (!quiz || !sol || strlen(quiz) < 81 || strlen(sol) < 81) {
-        fprintf(stderr, "Malformed line in sudoku.csv\n");
-        exit(1);
+        // Hard puzzles must not fall to singles alone; keep the last try
+        // if none of them does
+        if (d != DIFFICULTY_HARD || !solve_singles(puzzle))
+            return;
     }
+}
 
-    // Fill puzzle and solution boards
-    for (int i = 0; i < 81; ++i) {
-        int r = i / 9;
-        int c = i % 9;
-        puzzle[r][c] = quiz[i] - '0';
-        solution[r][c] = sol[i] - '0';
+bool generator_open(const char *path)
+{
+    if (g_db_open)
+        puzzledb_close(&g_db);
+    g_db_open = puzzledb_open(&g_db, path);
+    return g_db_open;
+}
+
+void generator_close(void)
+{
+    if (g_db_open)
+        puzzledb_close(&g_db);
+    g_db_open = false;
+}
+
+void generate_puzzle(Board puzzle, Board solution) {
+    if (g_rng.state == 0)
+        gen_rng_seed(&g_rng, (uint64_t)time(NULL) ^ (uint64_t)(uintptr_t)&g_rng);
+
+    // Pick a random puzzle line
+    if (g_db_open && g_db.count > 0) {
+        size_t target = gen_rng_below(&g_rng, (uint32_t)g_db.count);
+        if (puzzledb_get(&g_db, target, puzzle, solution))
+            return;
     }
 
-    fclose(f);
+    generate_random_puzzle(puzzle, solution, DIFFICULTY_ANY, 0, &g_rng);
 }
@@ -2,8 +2,44 @@
 #define GENERATOR_H
 
 #include "board.h"
+#include <stdbool.h>
+#include <stdint.h>
 
+typedef enum {
+    DIFFICULTY_ANY,
+    DIFFICULTY_EASY,    // ~36 clues, naked/hidden singles are enough
+    DIFFICULTY_MEDIUM,  // ~30 clues, naked/hidden singles are enough
+    DIFFICULTY_HARD     // as few clues as possible, needs guessing
+} Difficulty;
+
+// Small per-thread random generator (xorshift64*), so generating threads
+// never share rand() state
+typedef struct {
+    uint64_t state;
+} GenRng;
+
+void gen_rng_seed(GenRng *rng, uint64_t seed);
+uint32_t gen_rng_below(GenRng *rng, uint32_t n);
+
+const char *difficulty_name(Difficulty d);
+bool difficulty_from_name(const char *name, Difficulty *out);
+
+// Maps a puzzle file for generate_puzzle(). Without one (or if it holds no
+// valid rows) puzzles are generated instead.
+bool generator_open(const char *path);
+void generator_close(void);
+
+// Picks a random puzzle from the file generator_open() mapped, or
+// generates one if there is none. Safe to call from several threads; the
+// file is only opened and closed before and after they run.
 void generate_puzzle(Board puzzle, Board solution);
 
-#endif //GENERATOR_H
+// Random complete grid
+void generate_solution(Board solution, GenRng *rng);
 
+// Fresh puzzle with exactly one solution. target_clues > 0 overrides the
+// clue count implied by the difficulty.
+void generate_random_puzzle(Board puzzle, Board solution, Difficulty d,
+                            int target_clues, GenRng *rng);
+
+#endif //GENERATOR_H
@@ -0,0 +1,80 @@
+#include "hist.h"
+
+#include <string.h>
+
+unsigned hist_bucket(uint64_t v)
+{
+    if (v < HIST_SUB_BUCKETS)
+        return (unsigned)v;
+
+    // v >> shift keeps the top HIST_SUB_BITS + 1 bits: the leading one
+    // picks the power of two, the rest the step inside it
+    unsigned msb = 63u - (unsigned)__builtin_clzll(v);
+    unsigned shift = msb - HIST_SUB_BITS;
+    return (shift + 1) * HIST_SUB_BUCKETS + (unsigned)(v >> shift) - HIST_SUB_BUCKETS;
+}
+
+// Largest value that maps to bucket i
+static uint64_t hist_bucket_top(unsigned i)
+{
+    if (i < HIST_SUB_BUCKETS)
+        return i;
+
+    unsigned shift = i / HIST_SUB_BUCKETS - 1;
+    uint64_t step = i % HIST_SUB_BUCKETS + HIST_SUB_BUCKETS;
+    return ((step + 1) << shift) - 1;
+}
+
+void hist_init(Hist *h)
+{
+    memset(h, 0, sizeof(*h));
+    h->min = UINT64_MAX;
+}
+
+void hist_record(Hist *h, uint64_t value)
+{
+    h->counts[hist_bucket(value)]++;
+    h->total++;
+    h->sum += value;
+    if (value < h->min)
+        h->min = value;
+    if (value > h->max)
+        h->max = value;
+}
+
+void hist_merge(Hist *into, const Hist *from)
+{
+    for (unsigned i = 0; i < HIST_BUCKETS; i++)
+        into->counts[i] += from->counts[i];
+    into->total += from->total;
+    into->sum += from->sum;
+    if (from->min < into->min)
+        into->min = from->min;
+    if (from->max > into->max)
+        into->max = from->max;
+}
+
+uint64_t hist_percentile(const Hist *h, double pct)
+{
+    if (h->total == 0)
+        return 0;
+
+    uint64_t rank = (uint64_t)(pct / 100.0 * (double)h->total + 0.5);
+    if (rank < 1)
+        rank = 1;
+
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen >= rank) {
+            uint64_t top = hist_bucket_top(i);
+            return top < h->max ? top : h->max;
+        }
+    }
+    return h->max;
+}
+
+double hist_mean(const Hist *h)
+{
+    return h->total ? (double)h->sum / (double)h->total : 0.0;
+}
@@ -0,0 +1,40 @@
+#ifndef HIST_H
+#define HIST_H
+
+#include <stdint.h>
+
+// Latency histogram with bounded relative error, in the style of HDR
+// histograms: a value lands in the bucket for its power of two and one of
+// HIST_SUB_BUCKETS linear steps inside it, so any reported value is within
+// about 1/HIST_SUB_BUCKETS (3%) of what was recorded, from 1 up to
+// UINT64_MAX, in a fixed 15 KB. Not thread-safe; keep one per thread and
+// merge.
+
+#define HIST_SUB_BITS    5
+#define HIST_SUB_BUCKETS (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS     ((64 - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS)
+
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+} Hist;
+
+void hist_init(Hist *h);
+
+// Bucket a value is counted in, for callers that keep their own counts
+// (atomic ones shared between threads, say) and copy them into a Hist to
+// read percentiles
+unsigned hist_bucket(uint64_t value);
+
+void hist_record(Hist *h, uint64_t value);
+void hist_merge(Hist *into, const Hist *from);
+
+// Smallest recorded value (to bucket precision) that at least pct percent
+// of the values do not exceed; 0 if nothing was recorded
+uint64_t hist_percentile(const Hist *h, double pct);
+double hist_mean(const Hist *h);
+
+#endif //HIST_H
@@ -0,0 +1,121 @@
+#include "linebuf.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <winsock2.h>
+    #include <io.h>
+    #define read _read
+#else
+    #include <sys/socket.h>
+    #include <unistd.h>
+#endif
+
+#define LINEBUF_MIN_CAP 1024
+
+bool linebuf_init(LineBuf *lb, size_t max_line)
+{
+    memset(lb, 0, sizeof(*lb));
+    lb->max_line = max_line;
+    lb->cap = max_line * 2 > LINEBUF_MIN_CAP ? max_line * 2 : LINEBUF_MIN_CAP;
+    lb->data = malloc(lb->cap);
+    return lb->data != NULL;
+}
+
+void linebuf_free(LineBuf *lb)
+{
+    free(lb->data);
+    lb->data = NULL;
+}
+
+// Slides the unfinished line to the front; lines handed out before a fill
+// are no longer needed
+static void linebuf_compact(LineBuf *lb)
+{
+    if (lb->start > 0) {
+        memmove(lb->data, lb->data + lb->start, lb->end - lb->start);
+        lb->end -= lb->start;
+        lb->start = 0;
+    }
+}
+
+long linebuf_fill(LineBuf *lb, int fd)
+{
+    linebuf_compact(lb);
+
+    for (;;) {
+        long n = (long)recv(fd, lb->data + lb->end, (int)(lb->cap - lb->end), 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n > 0)
+            lb->end += (size_t)n;
+        return n;
+    }
+}
+
+long linebuf_read(LineBuf *lb, int fd)
+{
+    linebuf_compact(lb);
+
+    for (;;) {
+        long n = (long)read(fd, lb->data + lb->end, (unsigned)(lb->cap - lb->end));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n > 0)
+            lb->end += (size_t)n;
+        return n;
+    }
+}
+
+char *linebuf_next(LineBuf *lb, size_t *len)
+{
+    for (;;) {
+        size_t avail = lb->end - lb->start;
+        char *begin = lb->data + lb->start;
+        char *nl = memchr(begin + lb->scanned, '\n', avail - lb->scanned);
+
+        if (!nl) {
+            lb->scanned = avail;
+            if (avail > lb->max_line) {
+                // Too long to ever be accepted: drop what we have and
+                // skip the rest of it as it arrives
+                lb->discarding = true;
+                lb->start = lb->end;
+                lb->scanned = 0;
+            }
+            return NULL;
+        }
+
+        size_t n = (size_t)(nl - begin);
+        lb->start += n + 1;
+        lb->scanned = 0;
+
+        if (lb->discarding || n > lb->max_line) {
+            lb->discarding = false;
+            continue;
+        }
+
+        if (n > 0 && begin[n - 1] == '\r')
+            n--;
+        begin[n] = '\0';
+        if (len)
+            *len = n;
+        return begin;
+    }
+}
+
+const char *linebuf_peek(const LineBuf *lb, size_t *len)
+{
+    *len = lb->end - lb->start;
+    return lb->data + lb->start;
+}
+
+void linebuf_consume(LineBuf *lb, size_t n)
+{
+    if (n > lb->end - lb->start)
+        n = lb->end - lb->start;
+    lb->start += n;
+    lb->scanned = 0;
+}
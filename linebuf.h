@@ -0,0 +1,43 @@
+#ifndef LINEBUF_H
+#define LINEBUF_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Receive buffer for line-based sockets. linebuf_fill() reads whatever the
+// socket has in one recv(); linebuf_next() then hands out complete lines in
+// place, so a burst of input costs one syscall however many lines it holds.
+// A partial line stays buffered until the rest arrives. Lines longer than
+// max_line are dropped whole instead of being split.
+
+typedef struct {
+    char *data;
+    size_t cap;
+    size_t start;       // first unread byte
+    size_t end;         // one past the last buffered byte
+    size_t scanned;     // bytes after start already searched for '\n'
+    size_t max_line;
+    bool discarding;    // inside an overlong line, skipping to its '\n'
+} LineBuf;
+
+bool linebuf_init(LineBuf *lb, size_t max_line);
+void linebuf_free(LineBuf *lb);
+
+// One recv() into the free space. Returns the byte count, 0 on EOF and -1
+// on error (errno is left set, EAGAIN included).
+long linebuf_fill(LineBuf *lb, int fd);
+
+// Same as linebuf_fill() for descriptors recv() cannot read, such as stdin
+// on a terminal or a pipe
+long linebuf_read(LineBuf *lb, int fd);
+
+// Next complete line without its "\n" or "\r\n", NUL-terminated inside the
+// buffer, or NULL if none is buffered. Valid until the next linebuf_fill().
+char *linebuf_next(LineBuf *lb, size_t *len);
+
+// Raw access for binary framing on the same stream: the buffered bytes not
+// consumed yet, and dropping the first n of them
+const char *linebuf_peek(const LineBuf *lb, size_t *len);
+void linebuf_consume(LineBuf *lb, size_t n);
+
+#endif //LINEBUF_H
@@ -0,0 +1,559 @@
+#include "loadgen.h"
+#include "board.h"
+#include "evloop.h"
+#include "generator.h"
+#include "hist.h"
+#include "linebuf.h"
+#include "net.h"
+#include "pool.h"
+#include "proto.h"
+#include "solver.h"
+#include "timeutil.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <winsock2.h>
+    #include <windows.h>
+    #define close closesocket
+#else
+    #include <signal.h>
+    #include <unistd.h>
+    #include <sys/socket.h>
+#endif
+
+#define LOADGEN_LINE_MAX 256    // only the WELCOME line comes before frames
+#define LOADGEN_EVENTS   256
+#define LOADGEN_TICK_MS  1      // while ramping up or thinking
+#define LOADGEN_IDLE_MS  50
+#define LOADGEN_RETRY_MS 100    // pause before redialling after a failed connect
+
+typedef enum {
+    BOT_RANDOM,         // random empty cell, random value
+    BOT_SOLVER          // random empty cell, value from solve()
+} BotStrategy;
+
+typedef struct {
+    const char *host;
+    int port;
+    int connections;
+    int threads;            // 0 = one per CPU
+    int seconds;
+    int connect_rate;       // new connections per second, 0 = all at once
+    int think_ms;           // pause before answering a prompt
+    BotStrategy strategy;
+    Difficulty difficulty;  // asked for in HELLO
+    char hello[96];
+} LoadgenOptions;
+
+typedef enum {
+    BOT_IDLE,           // not connected, dials at dial_at_ns
+    BOT_CONNECTING,
+    BOT_HELLO,          // HELLO sent, waiting for WELCOME
+    BOT_PLAYING
+} BotState;
+
+typedef struct Worker Worker;
+
+typedef struct {
+    Worker *worker;
+    int fd;
+    BotState state;
+    bool connected_once;
+    int player;                 // 1 or 2 once the server has said
+    LineBuf in;
+    Board board;
+    Board solution;
+    bool have_solution;
+    ProtoMsgType prompt;        // prompt to answer at answer_at_ns, or 0
+    uint64_t answer_at_ns;
+    uint64_t dial_at_ns;
+    uint64_t dial_start_ns;
+    uint64_t move_sent_ns;      // 0 unless a move is waiting for its NOTE
+} Bot;
+
+// Read live by the main thread for the progress lines
+typedef struct {
+    atomic_uint_fast64_t connects;
+    atomic_uint_fast64_t failures;  // connects that did not succeed
+    atomic_uint_fast64_t drops;     // established connections lost
+    atomic_uint_fast64_t moves;     // moves answered by a NOTE
+    atomic_uint_fast64_t games;
+} WorkerCounters;
+
+struct Worker {
+    const LoadgenOptions *opt;
+    EvLoop *loop;
+    Bot *bots;
+    int nbots;
+    int first_connects;         // bots that have connected at least once
+    uint64_t ramp_done_ns;      // when first_connects reached nbots
+    GenRng rng;
+    WorkerCounters counters;
+    Hist connect_ns;            // the histograms belong to the worker
+    Hist rtt_ns;                // until it is joined
+    pthread_t thread;
+};
+
+static atomic_bool g_stop;
+
+static void sleep_ms(int ms)
+{
+#ifdef _WIN32
+    Sleep((DWORD)ms);
+#else
+    usleep((useconds_t)ms * 1000);
+#endif
+}
+
+static void bot_close(Bot *b, uint64_t redial_at_ns)
+{
+    if (b->fd >= 0) {
+        evloop_del(b->worker->loop, b->fd);
+        close(b->fd);
+        b->fd = -1;
+    }
+
+    size_t pending;
+    linebuf_peek(&b->in, &pending);
+    linebuf_consume(&b->in, pending);
+
+    b->state = BOT_IDLE;
+    b->player = 0;
+    b->prompt = 0;
+    b->move_sent_ns = 0;
+    b->have_solution = false;
+    b->dial_at_ns = redial_at_ns;
+}
+
+// An established connection went away; dial again straight away
+static void bot_drop(Bot *b, uint64_t now)
+{
+    atomic_fetch_add_explicit(&b->worker->counters.drops, 1, memory_order_relaxed);
+    bot_close(b, now);
+}
+
+static void bot_fail(Bot *b, uint64_t now)
+{
+    atomic_fetch_add_explicit(&b->worker->counters.failures, 1, memory_order_relaxed);
+    bot_close(b, now + (uint64_t)LOADGEN_RETRY_MS * 1000000u);
+}
+
+static void bot_dial(Bot *b, uint64_t now)
+{
+    const LoadgenOptions *opt = b->worker->opt;
+
+    b->dial_start_ns = now;
+    b->fd = net_connect_start(opt->host, opt->port);
+    if (b->fd < 0 || evloop_add(b->worker->loop, b->fd, EV_WRITE, b) < 0) {
+        bot_fail(b, now);
+        return;
+    }
+    b->state = BOT_CONNECTING;
+}
+
+// Frames are a handful of bytes, so a send that does not take all of one
+// means the server has stopped reading
+static bool bot_send(Bot *b, const void *data, size_t len)
+{
+    long n = (long)send(b->fd, data, (int)len, 0);
+    return n == (long)len;
+}
+
+static void bot_on_connected(Bot *b, uint64_t now)
+{
+    Worker *w = b->worker;
+
+    if (net_connect_error(b->fd) != 0) {
+        bot_fail(b, now);
+        return;
+    }
+
+    atomic_fetch_add_explicit(&w->counters.connects, 1, memory_order_relaxed);
+    hist_record(&w->connect_ns, now - b->dial_start_ns);
+    if (!b->connected_once) {
+        b->connected_once = true;
+        if (++w->first_connects == w->nbots)
+            w->ramp_done_ns = now;
+    }
+
+    if (!bot_send(b, w->opt->hello, strlen(w->opt->hello)) ||
+        evloop_mod(w->loop, b->fd, EV_READ, b) < 0) {
+        bot_drop(b, now);
+        return;
+    }
+    b->state = BOT_HELLO;
+}
+
+static void bot_pick_move(Bot *b, int *cell, int *value)
+{
+    int empty[BOARD_LINE_LEN];
+    int n = 0;
+
+    for (int i = 0; i < BOARD_LINE_LEN; i++) {
+        if (b->board[i / BOARDSIZE][i % BOARDSIZE] == 0)
+            empty[n++] = i;
+    }
+
+    *cell = n ? empty[gen_rng_below(&b->worker->rng, (uint32_t)n)] : 0;
+    if (b->have_solution)
+        *value = b->solution[*cell / BOARDSIZE][*cell % BOARDSIZE];
+    else
+        *value = 1 + (int)gen_rng_below(&b->worker->rng, BOARDSIZE);
+}
+
+static bool bot_answer(Bot *b, uint64_t now)
+{
+    uint8_t frame[PROTO_HEADER + 2];
+    size_t size;
+
+    if (b->prompt == MSG_YOUR_MOVE) {
+        int cell, value;
+        bot_pick_move(b, &cell, &value);
+        uint8_t move[2] = { (uint8_t)cell, (uint8_t)value };
+        size = proto_encode(frame, MSG_MOVE, move, sizeof(move));
+        b->move_sent_ns = now;
+    } else {
+        // Always move on, so the server keeps loading puzzles
+        uint8_t choice = 'N';
+        size = proto_encode(frame, MSG_CHOICE, &choice, 1);
+    }
+
+    b->prompt = 0;
+    return bot_send(b, frame, size);
+}
+
+// false if the connection has to be dropped
+static bool bot_on_frame(Bot *b, const uint8_t *frame, size_t size, uint64_t now)
+{
+    Worker *w = b->worker;
+    const uint8_t *p = frame + PROTO_HEADER;
+    size_t len = size - PROTO_HEADER;
+
+    switch (frame[0]) {
+    case MSG_PLAYER:
+        if (len >= 1)
+            b->player = p[0];
+        break;
+    case MSG_PUZZLE:
+        if (len < PROTO_BOARD_BYTES)
+            return false;
+        proto_unpack_board(p, b->board);
+        b->have_solution = false;
+        if (w->opt->strategy == BOT_SOLVER) {
+            memcpy(b->solution, b->board, sizeof(Board));
+            b->have_solution = solve(b->solution);
+        }
+        break;
+    case MSG_SET:
+        if (len >= 2 && p[0] < BOARD_LINE_LEN)
+            b->board[p[0] / BOARDSIZE][p[0] % BOARDSIZE] = p[1];
+        break;
+    case MSG_NOTE:
+        if (b->move_sent_ns) {
+            hist_record(&w->rtt_ns, now - b->move_sent_ns);
+            atomic_fetch_add_explicit(&w->counters.moves, 1, memory_order_relaxed);
+            b->move_sent_ns = 0;
+        }
+        break;
+    case MSG_END:
+        // Both players see it; count each room once
+        if (b->player == 1)
+            atomic_fetch_add_explicit(&w->counters.games, 1, memory_order_relaxed);
+        break;
+    case MSG_TURN:
+    case MSG_MENU:
+        // A prompt still being thought about has timed out
+        b->prompt = 0;
+        break;
+    case MSG_YOUR_MOVE:
+    case MSG_YOUR_MENU:
+        b->prompt = (ProtoMsgType)frame[0];
+        b->answer_at_ns = now + (uint64_t)w->opt->think_ms * 1000000u;
+        if (w->opt->think_ms == 0)
+            return bot_answer(b, now);
+        break;
+    default:
+        break;
+    }
+    return true;
+}
+
+static void bot_on_readable(Bot *b, uint64_t now)
+{
+    long n = linebuf_fill(&b->in, b->fd);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return;
+    if (n <= 0) {
+        bot_drop(b, now);
+        return;
+    }
+
+    char *line;
+    while (b->state == BOT_HELLO && (line = linebuf_next(&b->in, NULL)) != NULL) {
+        if (strncmp(line, "WELCOME mode=binary", 19) != 0) {
+            fprintf(stderr, "LOADGEN: server refused binary mode: %s\n", line);
+            bot_drop(b, now);
+            return;
+        }
+        b->state = BOT_PLAYING;
+    }
+
+    while (b->state == BOT_PLAYING) {
+        size_t avail;
+        const uint8_t *buf = (const uint8_t *)linebuf_peek(&b->in, &avail);
+        long size = proto_frame_size(buf, avail);
+        if (size == 0)
+            return;
+        if (size < 0 || !bot_on_frame(b, buf, (size_t)size, now)) {
+            bot_drop(b, now);
+            return;
+        }
+        linebuf_consume(&b->in, (size_t)size);
+    }
+}
+
+// Dials bots that are due and answers prompts whose think time is over
+static void worker_tick(Worker *w, uint64_t now)
+{
+    for (int i = 0; i < w->nbots; i++) {
+        Bot *b = &w->bots[i];
+        if (b->state == BOT_IDLE && now >= b->dial_at_ns)
+            bot_dial(b, now);
+        else if (b->state == BOT_PLAYING && b->prompt && now >= b->answer_at_ns && !bot_answer(b, now))
+            bot_drop(b, now);
+    }
+}
+
+static void *worker_main(void *arg)
+{
+    Worker *w = arg;
+    EvEvent events[LOADGEN_EVENTS];
+
+    while (!atomic_load(&g_stop)) {
+        bool busy = w->opt->think_ms > 0 || w->first_connects < w->nbots;
+        int n = evloop_wait(w->loop, events, LOADGEN_EVENTS, busy ? LOADGEN_TICK_MS : LOADGEN_IDLE_MS);
+        uint64_t now = time_now_ns();
+
+        for (int i = 0; i < n; i++) {
+            Bot *b = events[i].data;
+            if (b->fd < 0)
+                continue;   // dropped earlier in this batch
+            if (b->state == BOT_CONNECTING)
+                bot_on_connected(b, now);
+            else if (events[i].events & (EV_READ | EV_ERROR))
+                bot_on_readable(b, now);
+        }
+
+        worker_tick(w, now);
+    }
+
+    for (int i = 0; i < w->nbots; i++)
+        bot_close(&w->bots[i], 0);
+    return NULL;
+}
+
+static bool loadgen_parse_options(LoadgenOptions *opt, int argc, char *argv[])
+{
+    int positional = 0;
+
+    for (int i = 0; i < argc; i++) {
+        const char *a = argv[i];
+        if (strcmp(a, "--connections") == 0 && i + 1 < argc) {
+            opt->connections = atoi(argv[++i]);
+        } else if (strcmp(a, "--threads") == 0 && i + 1 < argc) {
+            opt->threads = atoi(argv[++i]);
+        } else if (strcmp(a, "--seconds") == 0 && i + 1 < argc) {
+            opt->seconds = atoi(argv[++i]);
+        } else if (strcmp(a, "--connect-rate") == 0 && i + 1 < argc) {
+            opt->connect_rate = atoi(argv[++i]);
+        } else if (strcmp(a, "--think-ms") == 0 && i + 1 < argc) {
+            opt->think_ms = atoi(argv[++i]);
+        } else if (strcmp(a, "--bot") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            if (strcmp(name, "random") == 0)
+                opt->strategy = BOT_RANDOM;
+            else if (strcmp(name, "solver") == 0)
+                opt->strategy = BOT_SOLVER;
+            else
+                return false;
+        } else if (strcmp(a, "--difficulty") == 0 && i + 1 < argc) {
+            if (!difficulty_from_name(argv[++i], &opt->difficulty))
+                return false;
+        } else if (a[0] != '-' && positional == 0) {
+            opt->host = a;
+            positional++;
+        } else if (a[0] != '-' && positional == 1) {
+            opt->port = atoi(a);
+            positional++;
+        } else {
+            return false;
+        }
+    }
+
+    return opt->port > 0 && opt->connections > 0 && opt->threads >= 0 &&
+           opt->seconds > 0 && opt->connect_rate >= 0 && opt->think_ms >= 0;
+}
+
+static void print_latency(const char *label, const Hist *h)
+{
+    printf("  %-14s mean %8.1f  p50 %8.1f  p90 %8.1f  p99 %8.1f  p99.9 %8.1f  max %8.1f  (us, %llu samples)\n",
+           label, hist_mean(h) / 1e3,
+           hist_percentile(h, 50) / 1e3, hist_percentile(h, 90) / 1e3,
+           hist_percentile(h, 99) / 1e3, hist_percentile(h, 99.9) / 1e3,
+           (h->total ? h->max : 0) / 1e3, (unsigned long long)h->total);
+}
+
+int run_loadgen(int argc, char *argv[])
+{
+    LoadgenOptions opt = {
+        .host = "127.0.0.1",
+        .port = 5555,
+        .connections = 100,
+        .seconds = 10,
+        .strategy = BOT_SOLVER,
+    };
+
+    if (!loadgen_parse_options(&opt, argc, argv)) {
+        fprintf(stderr, "Error: usage: loadgen [ADDRESS] [PORT] [--connections N] [--threads N] "
+                        "[--seconds S] [--connect-rate N] [--think-ms N] [--bot random|solver] "
+                        "[--difficulty LEVEL]\n");
+        return 1;
+    }
+    snprintf(opt.hello, sizeof(opt.hello), "HELLO mode=binary version=%d difficulty=%s\n",
+             PROTO_VERSION, difficulty_name(opt.difficulty));
+
+#ifndef _WIN32
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    int nworkers = opt.threads > 0 ? opt.threads : pool_cpu_count();
+    if (nworkers > opt.connections)
+        nworkers = opt.connections;
+
+    Worker *workers = calloc((size_t)nworkers, sizeof(Worker));
+    if (!workers) {
+        perror("calloc");
+        return 1;
+    }
+
+    // Bot i dials at start + i / rate, whichever worker owns it
+    uint64_t start = time_now_ns();
+    uint64_t interval = opt.connect_rate ? 1000000000u / (uint64_t)opt.connect_rate : 0;
+
+    for (int t = 0; t < nworkers; t++) {
+        Worker *w = &workers[t];
+        w->opt = &opt;
+        w->loop = evloop_create();
+        w->nbots = opt.connections / nworkers + (t < opt.connections % nworkers);
+        w->bots = calloc((size_t)w->nbots, sizeof(Bot));
+        if (!w->loop || !w->bots) {
+            fprintf(stderr, "LOADGEN: could not set up worker %d\n", t);
+            return 1;
+        }
+        gen_rng_seed(&w->rng, start ^ ((uint64_t)t << 32));
+        hist_init(&w->connect_ns);
+        hist_init(&w->rtt_ns);
+
+        for (int i = 0; i < w->nbots; i++) {
+            Bot *b = &w->bots[i];
+            b->worker = w;
+            b->fd = -1;
+            b->dial_at_ns = start + (uint64_t)(i * nworkers + t) * interval;
+            if (!linebuf_init(&b->in, LOADGEN_LINE_MAX)) {
+                perror("malloc");
+                return 1;
+            }
+        }
+    }
+
+    printf("LOADGEN: %d %s bot%s against %s:%d on %d thread%s for %d s\n",
+           opt.connections, opt.strategy == BOT_SOLVER ? "solver" : "random",
+           opt.connections == 1 ? "" : "s", opt.host, opt.port,
+           nworkers, nworkers == 1 ? "" : "s", opt.seconds);
+    fflush(stdout);
+
+    atomic_store(&g_stop, false);
+    for (int t = 0; t < nworkers; t++) {
+        if (pthread_create(&workers[t].thread, NULL, worker_main, &workers[t]) != 0) {
+            perror("pthread_create");
+            return 1;
+        }
+    }
+
+    uint64_t last_moves = 0;
+    for (int s = 1; s <= opt.seconds; s++) {
+        sleep_ms(1000);
+
+        uint64_t connects = 0, drops = 0, failures = 0, moves = 0, games = 0;
+        for (int t = 0; t < nworkers; t++) {
+            WorkerCounters *c = &workers[t].counters;
+            connects += atomic_load_explicit(&c->connects, memory_order_relaxed);
+            drops += atomic_load_explicit(&c->drops, memory_order_relaxed);
+            failures += atomic_load_explicit(&c->failures, memory_order_relaxed);
+            moves += atomic_load_explicit(&c->moves, memory_order_relaxed);
+            games += atomic_load_explicit(&c->games, memory_order_relaxed);
+        }
+        printf("  t=%3ds  connected %6llu  moves/s %8llu  games %6llu  failed %llu\n", s,
+               (unsigned long long)(connects - drops), (unsigned long long)(moves - last_moves),
+               (unsigned long long)games, (unsigned long long)failures);
+        fflush(stdout);
+        last_moves = moves;
+    }
+
+    atomic_store(&g_stop, true);
+    for (int t = 0; t < nworkers; t++)
+        pthread_join(workers[t].thread, NULL);
+    double elapsed = (double)(time_now_ns() - start) / 1e9;
+
+    Hist connect_ns, rtt_ns;
+    hist_init(&connect_ns);
+    hist_init(&rtt_ns);
+    uint64_t connects = 0, drops = 0, failures = 0, moves = 0, games = 0, ramp_done = 0;
+    int up = 0;
+    for (int t = 0; t < nworkers; t++) {
+        Worker *w = &workers[t];
+        hist_merge(&connect_ns, &w->connect_ns);
+        hist_merge(&rtt_ns, &w->rtt_ns);
+        connects += atomic_load(&w->counters.connects);
+        drops += atomic_load(&w->counters.drops);
+        failures += atomic_load(&w->counters.failures);
+        moves += atomic_load(&w->counters.moves);
+        games += atomic_load(&w->counters.games);
+        up += w->first_connects;
+        if (w->ramp_done_ns > ramp_done)
+            ramp_done = w->ramp_done_ns;
+    }
+
+    printf("LOADGEN: results over %.1f s\n", elapsed);
+    if (up == opt.connections) {
+        double ramp = (double)(ramp_done - start) / 1e9;
+        printf("  connections    %d up in %.3f s (%.0f/s), %llu failed, %llu dropped and redialled\n",
+               up, ramp, ramp > 0 ? up / ramp : 0.0,
+               (unsigned long long)failures, (unsigned long long)drops);
+    } else {
+        printf("  connections    only %d of %d ever came up, %llu failed, %llu dropped\n",
+               up, opt.connections, (unsigned long long)failures, (unsigned long long)drops);
+    }
+    printf("  moves          %llu (%.0f/s), %llu exercises finished, %llu connects in total\n",
+           (unsigned long long)moves, moves / elapsed,
+           (unsigned long long)games, (unsigned long long)connects);
+    print_latency("connect", &connect_ns);
+    print_latency("move rtt", &rtt_ns);
+
+    for (int t = 0; t < nworkers; t++) {
+        for (int i = 0; i < workers[t].nbots; i++)
+            linebuf_free(&workers[t].bots[i].in);
+        free(workers[t].bots);
+        evloop_destroy(workers[t].loop);
+    }
+    free(workers);
+    return 0;
+}
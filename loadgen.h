@@ -0,0 +1,16 @@
+#ifndef LOADGEN_H
+#define LOADGEN_H
+
+// Capacity testing: opens many bot players against a server over the
+// binary protocol and reports connection rate, moves per second and move
+// round-trip latency. argv holds the arguments after the mode name:
+//
+//   [ADDRESS] [PORT] [--connections N] [--threads N] [--seconds S]
+//   [--connect-rate N] [--think-ms N] [--bot random|solver]
+//   [--difficulty LEVEL]
+//
+// Bots that lose their connection (partner gone, server restart) dial
+// again, so the number of players stays at N for the whole run.
+int run_loadgen(int argc, char *argv[]);
+
+#endif //LOADGEN_H
@@ -0,0 +1,319 @@
+#include "metrics.h"
+#include "hist.h"
+#include "net.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifdef _WIN32
+    #include <winsock2.h>
+    #include <windows.h>
+    #define close closesocket
+    #define SEND_FLAGS 0
+#else
+    #include <unistd.h>
+    #include <sys/socket.h>
+    #define SEND_FLAGS MSG_NOSIGNAL
+#endif
+
+#define ADMIN_REQUEST_MAX 1024
+#define ADMIN_WAIT_MS     1000  // socket timeout for the request and each send
+#define ADMIN_BACKOFF_MS  100   // after accept fails, out of descriptors say
+
+typedef struct {
+    atomic_ullong counts[HIST_BUCKETS];
+    atomic_ullong sum;
+    atomic_ullong max;
+} SharedHist;
+
+struct MetricsShard {
+    atomic_ullong counters[METRIC_COUNTERS];
+    atomic_llong gauges[METRIC_GAUGES];
+    SharedHist latencies[METRIC_LATENCIES];
+};
+
+typedef struct {
+    const char *name;
+    const char *help;
+} MetricInfo;
+
+static const MetricInfo counter_info[METRIC_COUNTERS] = {
+    [METRIC_CONNECTIONS]     = { "sudoku_connections_total", "Connections accepted" },
+    [METRIC_GAMES]           = { "sudoku_games_total", "Rooms that started a game" },
+    [METRIC_MOVES]           = { "sudoku_moves_total", "Moves handled" },
+    [METRIC_BYTES_IN]        = { "sudoku_received_bytes_total", "Bytes read from clients" },
+    [METRIC_BYTES_OUT]       = { "sudoku_sent_bytes_total", "Bytes written to clients" },
+    [METRIC_PREFETCH_MISSES] = { "sudoku_prefetch_misses_total",
+                                 "Puzzles made on a reactor because the prefetch ring was empty" },
+    [METRIC_SEND_BACKLOGS]   = { "sudoku_send_backlogs_total",
+                                 "Sends that left bytes in a connection's queue" },
+    [METRIC_RESYNCS]         = { "sudoku_spectator_resyncs_total",
+                                 "Spectator backlogs replaced by a snapshot" },
+    [METRIC_SKIPPED_BYTES]   = { "sudoku_spectator_skipped_bytes_total",
+                                 "Bytes dropped from spectator backlogs" },
+    [METRIC_SLOW_PLAYERS]    = { "sudoku_slow_players_total",
+                                 "Players disconnected for a full send queue" },
+    [METRIC_IDLE_PLAYERS]    = { "sudoku_idle_players_total",
+                                 "Players disconnected for sending nothing" },
+};
+
+static const MetricInfo gauge_info[METRIC_GAUGES] = {
+    [GAUGE_CONNECTIONS] = { "sudoku_connections", "Open connections" },
+    [GAUGE_ROOMS]       = { "sudoku_rooms", "Rooms waiting or playing" },
+    [GAUGE_SPECTATORS]  = { "sudoku_spectators", "Connected spectators" },
+    [GAUGE_QUEUE_PEAK]  = { "sudoku_send_queue_peak_bytes", "Deepest send queue seen" },
+};
+
+static const MetricInfo latency_info[METRIC_LATENCIES] = {
+    [LATENCY_MOVE]        = { "sudoku_move_processing_seconds",
+                              "From a move arriving to its output handed to the sockets" },
+    [LATENCY_TURN_TTFB]   = { "sudoku_turn_first_byte_seconds",
+                              "From the end of a turn to the first byte of the next one sent" },
+    [LATENCY_PUZZLE_LOAD] = { "sudoku_puzzle_load_seconds", "Time to get the next puzzle" },
+};
+
+static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999, 1.0 };
+
+static MetricsShard *g_shards;
+static int g_nshards;
+
+bool metrics_init(int nshards)
+{
+    g_shards = calloc((size_t)nshards, sizeof(MetricsShard));
+    if (!g_shards)
+        return false;
+    g_nshards = nshards;
+    return true;
+}
+
+MetricsShard *metrics_shard(int i)
+{
+    return &g_shards[i];
+}
+
+void metrics_count(MetricsShard *m, MetricCounter c, uint64_t n)
+{
+    atomic_fetch_add_explicit(&m->counters[c], n, memory_order_relaxed);
+}
+
+void metrics_gauge(MetricsShard *m, MetricGauge g, int64_t delta)
+{
+    atomic_fetch_add_explicit(&m->gauges[g], delta, memory_order_relaxed);
+}
+
+void metrics_peak(MetricsShard *m, MetricGauge g, int64_t value)
+{
+    // Only the shard's own thread raises it, so no compare-and-swap
+    if (value > atomic_load_explicit(&m->gauges[g], memory_order_relaxed))
+        atomic_store_explicit(&m->gauges[g], value, memory_order_relaxed);
+}
+
+void metrics_latency(MetricsShard *m, MetricLatency l, uint64_t ns)
+{
+    SharedHist *h = &m->latencies[l];
+    atomic_fetch_add_explicit(&h->counts[hist_bucket(ns)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->sum, ns, memory_order_relaxed);
+    if (ns > atomic_load_explicit(&h->max, memory_order_relaxed))
+        atomic_store_explicit(&h->max, ns, memory_order_relaxed);
+}
+
+uint64_t metrics_total(MetricCounter c)
+{
+    uint64_t total = 0;
+    for (int i = 0; i < g_nshards; i++)
+        total += atomic_load_explicit(&g_shards[i].counters[c], memory_order_relaxed);
+    return total;
+}
+
+int64_t metrics_gauge_value(MetricGauge g)
+{
+    int64_t value = 0;
+    for (int i = 0; i < g_nshards; i++) {
+        int64_t v = atomic_load_explicit(&g_shards[i].gauges[g], memory_order_relaxed);
+        if (g != GAUGE_QUEUE_PEAK)
+            value += v;
+        else if (v > value)
+            value = v;
+    }
+    return value;
+}
+
+// Every shard's counts for one latency. Writers keep going meanwhile, so
+// the total is taken from the buckets themselves to stay consistent.
+static void latency_snapshot(MetricLatency l, Hist *h)
+{
+    hist_init(h);
+    for (int s = 0; s < g_nshards; s++) {
+        SharedHist *sh = &g_shards[s].latencies[l];
+        for (unsigned i = 0; i < HIST_BUCKETS; i++) {
+            uint64_t n = atomic_load_explicit(&sh->counts[i], memory_order_relaxed);
+            h->counts[i] += n;
+            h->total += n;
+        }
+        h->sum += atomic_load_explicit(&sh->sum, memory_order_relaxed);
+        uint64_t max = atomic_load_explicit(&sh->max, memory_order_relaxed);
+        if (max > h->max)
+            h->max = max;
+    }
+}
+
+typedef struct {
+    char *buf;
+    size_t cap;
+    size_t len;
+} Text;
+
+static void text_printf(Text *t, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(t->len < t->cap ? t->buf + t->len : NULL,
+                      t->len < t->cap ? t->cap - t->len : 0, fmt, ap);
+    va_end(ap);
+    if (n > 0)
+        t->len += (size_t)n;
+}
+
+static void text_header(Text *t, const MetricInfo *info, const char *type)
+{
+    text_printf(t, "# HELP %s %s\n# TYPE %s %s\n", info->name, info->help, info->name, type);
+}
+
+size_t metrics_render(char *buf, size_t cap)
+{
+    Text t = { buf, cap, 0 };
+    Hist *h = malloc(sizeof(*h));
+
+    if (cap > 0)
+        buf[0] = '\0';
+
+    for (int c = 0; c < METRIC_COUNTERS; c++) {
+        text_header(&t, &counter_info[c], "counter");
+        text_printf(&t, "%s %llu\n", counter_info[c].name,
+                    (unsigned long long)metrics_total((MetricCounter)c));
+    }
+    for (int g = 0; g < METRIC_GAUGES; g++) {
+        text_header(&t, &gauge_info[g], "gauge");
+        text_printf(&t, "%s %lld\n", gauge_info[g].name,
+                    (long long)metrics_gauge_value((MetricGauge)g));
+    }
+    for (int l = 0; h && l < METRIC_LATENCIES; l++) {
+        const char *name = latency_info[l].name;
+        latency_snapshot((MetricLatency)l, h);
+        text_header(&t, &latency_info[l], "summary");
+        for (size_t q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); q++)
+            text_printf(&t, "%s{quantile=\"%g\"} %.9f\n", name, quantiles[q],
+                        (double)hist_percentile(h, quantiles[q] * 100.0) / 1e9);
+        text_printf(&t, "%s_sum %.9f\n%s_count %llu\n", name, (double)h->sum / 1e9,
+                    name, (unsigned long long)h->total);
+    }
+
+    free(h);
+    return t.len;
+}
+
+static void sleep_ms(int ms)
+{
+#ifdef _WIN32
+    Sleep((DWORD)ms);
+#else
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+#endif
+}
+
+// Gives up once a send has waited ADMIN_WAIT_MS, so a scraper that stops
+// reading cannot hold the only admin thread
+static bool admin_send(int fd, const char *data, size_t len)
+{
+    while (len > 0) {
+        long n = (long)send(fd, data, (int)len, SEND_FLAGS);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        data += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+// One request per connection, HTTP/1.0 style. The path is not looked at:
+// there is only the one page.
+static void admin_reply(int fd)
+{
+    char req[ADMIN_REQUEST_MAX];
+    char head[160];
+
+    if (recv(fd, req, sizeof(req), 0) <= 0)
+        return;
+
+    // Rendered twice at most: the first pass says how big it is
+    size_t cap = 16384;
+    char *body = malloc(cap);
+    size_t len = body ? metrics_render(body, cap) : 0;
+    if (body && len >= cap) {
+        free(body);
+        cap = len + 1;
+        body = malloc(cap);
+        len = body ? metrics_render(body, cap) : 0;
+    }
+    if (!body)
+        return;
+
+    int hlen = snprintf(head, sizeof(head),
+                        "HTTP/1.0 200 OK\r\n"
+                        "Content-Type: text/plain; version=0.0.4\r\n"
+                        "Content-Length: %zu\r\n"
+                        "Connection: close\r\n\r\n", len);
+    if (admin_send(fd, head, (size_t)hlen))
+        admin_send(fd, body, len);
+    free(body);
+}
+
+// Serves one connection at a time. A failing accept is logged once per
+// run of failures and retried after a pause rather than in a tight loop.
+static void *admin_main(void *arg)
+{
+    int listen_fd = (int)(intptr_t)arg;
+    bool failing = false;
+
+    for (;;) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR)
+                continue;
+            if (!failing)
+                perror("metrics: accept");
+            failing = true;
+            sleep_ms(ADMIN_BACKOFF_MS);
+            continue;
+        }
+        failing = false;
+        net_set_timeouts(fd, ADMIN_WAIT_MS);
+        admin_reply(fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+bool metrics_serve(int port)
+{
+    pthread_t thread;
+    int fd = net_listen_local(port);
+    if (fd < 0)
+        return false;
+
+    if (pthread_create(&thread, NULL, admin_main, (void *)(intptr_t)fd) != 0) {
+        close(fd);
+        return false;
+    }
+    pthread_detach(thread);
+    return true;
+}
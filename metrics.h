@@ -0,0 +1,71 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Server telemetry. Every reactor thread updates its own shard with
+// relaxed atomic operations, so recording takes no lock and threads do not
+// share cache lines; a scrape sums the shards. Latencies go into
+// log-linear histograms with the bucketing of hist.h and are reported as
+// Prometheus summaries (quantiles, sum, count).
+//
+// metrics_serve() answers any HTTP request on 127.0.0.1:PORT with the
+// current values in the Prometheus text format.
+
+typedef enum {
+    METRIC_CONNECTIONS,         // accepted
+    METRIC_GAMES,               // rooms that started a game
+    METRIC_MOVES,
+    METRIC_BYTES_IN,
+    METRIC_BYTES_OUT,
+    METRIC_PREFETCH_MISSES,     // puzzles made on a reactor, ring empty
+    METRIC_SEND_BACKLOGS,       // sends the socket did not take whole
+    METRIC_RESYNCS,             // spectator backlogs replaced by a snapshot
+    METRIC_SKIPPED_BYTES,       // what those backlogs held
+    METRIC_SLOW_PLAYERS,        // players dropped for a full send queue
+    METRIC_IDLE_PLAYERS,        // players dropped for sending nothing
+    METRIC_COUNTERS
+} MetricCounter;
+
+typedef enum {
+    GAUGE_CONNECTIONS,
+    GAUGE_ROOMS,                // waiting and playing
+    GAUGE_SPECTATORS,
+    GAUGE_QUEUE_PEAK,           // deepest send queue seen, a maximum
+    METRIC_GAUGES
+} MetricGauge;
+
+typedef enum {
+    LATENCY_MOVE,               // move read to its output handed to sockets
+    LATENCY_TURN_TTFB,          // end of a turn to the next one's first byte
+    LATENCY_PUZZLE_LOAD,
+    METRIC_LATENCIES
+} MetricLatency;
+
+typedef struct MetricsShard MetricsShard;
+
+// One shard per writer thread; false if out of memory
+bool metrics_init(int nshards);
+MetricsShard *metrics_shard(int i);
+
+void metrics_count(MetricsShard *m, MetricCounter c, uint64_t n);
+void metrics_gauge(MetricsShard *m, MetricGauge g, int64_t delta);
+// Raises a maximum gauge to value if it is higher
+void metrics_peak(MetricsShard *m, MetricGauge g, int64_t value);
+void metrics_latency(MetricsShard *m, MetricLatency l, uint64_t ns);
+
+// Over all shards: the sum, or for GAUGE_QUEUE_PEAK the maximum
+uint64_t metrics_total(MetricCounter c);
+int64_t metrics_gauge_value(MetricGauge g);
+
+// Everything in the Prometheus text format. Returns the length it needs,
+// which may exceed cap; buf is NUL-terminated when cap > 0.
+size_t metrics_render(char *buf, size_t cap);
+
+// Serves metrics_render() from a thread of its own on the loopback port.
+// False if the port cannot be opened.
+bool metrics_serve(int port);
+
+#endif //METRICS_H
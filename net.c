@@ -1,5 +1,6 @@
 #include "net.h"
 
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
@@ -13,13 +14,14 @@
     #define close closesocket // Portability macro
 #else
     #include <unistd.h>
+    #include <fcntl.h>
     #include <arpa/inet.h>
     #include <sys/socket.h>
     #include <netinet/in.h> // Good practice for Unix-like systems
 #endif
 
 
-int net_listen(int port)
+static int listen_on(int port, bool shared, bool local)
 {
     int fd = socket(AF_INET, SOCK_STREAM, 0);
     if (fd < 0) {
@@ -28,16 +30,26 @@ int net_listen(int port)
     }
 
     int yes = 1;
-    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes)) < 0) {
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (const char *)&yes, sizeof(yes)) < 0) {
         perror("setsockopt");
         close(fd);
         return -1;
     }
 
+#ifdef SO_REUSEPORT
+    if (shared && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes)) < 0) {
+        perror("setsockopt(SO_REUSEPORT)");
+        close(fd);
+        return -1;
+    }
+#else
+    (void)shared;
+#endif
+
     struct sockaddr_in addr;
     memset(&addr, 0, sizeof(addr));
     addr.sin_family      = AF_INET;
-    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_addr.s_addr = htonl(local ? INADDR_LOOPBACK : INADDR_ANY);
     addr.sin_port        = htons((unsigned short)port);
 
     if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
@@ -46,7 +58,7 @@ int net_listen(int port)
         return -1;
     }
 
-    if (listen(fd, 2) < 0) {
+    if (listen(fd, SOMAXCONN) < 0) {
         perror("listen");
         close(fd);
         return -1;
@@ -55,6 +67,58 @@ int net_listen(int port)
     return fd;
 }
 
+int net_listen(int port)
+{
+    return listen_on(port, false, false);
+}
+
+int net_listen_local(int port)
+{
+    return listen_on(port, false, true);
+}
+
+int net_listen_shared(int port)
+{
+    // Only Linux spreads incoming connections across SO_REUSEPORT sockets;
+    // elsewhere the option just lets the last socket steal the port.
+#if defined(__linux__) && defined(SO_REUSEPORT)
+    return listen_on(port, true, false);
+#else
+    (void)port;
+    return -1;
+#endif
+}
+
+int net_set_nonblocking(int fd)
+{
+#ifdef _WIN32
+    u_long on = 1;
+    return ioctlsocket(fd, FIONBIO, &on) == 0 ? 0 : -1;
+#else
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0)
+        return -1;
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+#endif
+}
+
+int net_set_send_buffer(int fd, int bytes)
+{
+    return setsockopt(fd, SOL_SOCKET, SO_SNDBUF, (const char *)&bytes, sizeof(bytes));
+}
+
+int net_set_timeouts(int fd, int ms)
+{
+#ifdef _WIN32
+    DWORD timeout = (DWORD)ms;
+#else
+    struct timeval timeout = { ms / 1000, (ms % 1000) * 1000 };
+#endif
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, (const char *)&timeout, sizeof(timeout)) < 0)
+        return -1;
+    return setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, (const char *)&timeout, sizeof(timeout));
+}
+
 int net_accept(int listen_fd)
 {
     int fd = accept(listen_fd, NULL, NULL);
@@ -92,6 +156,57 @@ int net_connect(const char *host, int port)
     return fd;
 }
 
+int net_connect_start(const char *host, int port)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port   = htons((unsigned short)port);
+
+    if (inet_pton(AF_INET, host, &addr.sin_addr) <= 0) {
+        fprintf(stderr, "Invalid address '%s'\n", host);
+        return -1;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    if (net_set_nonblocking(fd) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+#ifdef _WIN32
+        bool pending = WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+        bool pending = errno == EINPROGRESS;
+#endif
+        if (!pending) {
+            close(fd);
+            return -1;
+        }
+    }
+
+    return fd;
+}
+
+int net_connect_error(int fd)
+{
+    int err = 0;
+#ifdef _WIN32
+    int len = sizeof(err);
+#else
+    socklen_t len = sizeof(err);
+#endif
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, (char *)&err, &len) < 0)
+        return errno ? errno : -1;
+    return err;
+}
+
 int net_send_line(int fd, const char *fmt, ...)
 {
     char buf[1024];
@@ -112,28 +227,3 @@ int net_send_line(int fd, const char *fmt, ...)
     ssize_t n = send(fd, buf, len, 0);
     return (n == (ssize_t)len) ? 0 : -1;
 }
-
-int net_recv_line(int fd, char *buf, int buflen)
-{
-    int pos = 0;
-    while (pos < buflen - 1) {
-        char c;
-        ssize_t n = recv(fd, &c, 1, 0);
-        if (n == 0) {
-            // EOF
-            if (pos == 0) return 0;
-            break;
-        }
-        if (n < 0) {
-            if (errno == EINTR) continue;
-            perror("recv");
-            return -1;
-        }
-        if (c == '\n') {
-            break;
-        }
-        buf[pos++] = c;
-    }
-    buf[pos] = '\0';
-    return 1;
-}
@@ -2,9 +2,25 @@
 #define NET_H
 
 int net_listen(int port);
+// Listener that shares the port with other sockets opened the same way, the
+// kernel balancing new connections between them. -1 where not supported.
+int net_listen_shared(int port);
+// Listener on the loopback interface only, for admin endpoints
+int net_listen_local(int port);
 int net_accept(int listen_fd);
+int net_set_nonblocking(int fd);
+// Fixes the kernel send buffer at about bytes instead of letting it grow to
+// megabytes, so a peer that stops reading shows up in the caller's own
+// queue soon
+int net_set_send_buffer(int fd, int bytes);
+// Makes a blocking recv or send give up after ms with EAGAIN / EWOULDBLOCK
+int net_set_timeouts(int fd, int ms);
 int net_connect(const char *host, int port);
+// Non-blocking connect: the fd once the attempt is under way (wait for it
+// to become writable, then ask net_connect_error), -1 if it failed at once
+int net_connect_start(const char *host, int port);
+// 0 once a started connect succeeded, else its error code
+int net_connect_error(int fd);
 int net_send_line(int fd, const char *fmt, ...);
-int net_recv_line(int fd, char *buf, int buflen);
 
 #endif //NET_H
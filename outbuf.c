@@ -0,0 +1,155 @@
+#include "outbuf.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <winsock2.h>
+#else
+    #include <sys/socket.h>
+    #include <sys/uio.h>
+#endif
+
+#define OUTQ_IOV     16     // blocks handed to one send
+#define OUTQ_MIN_CAP 8
+
+OutBuf *outbuf_new(const void *data, size_t len)
+{
+    OutBuf *b = malloc(sizeof(*b) + len);
+    if (!b)
+        return NULL;
+    atomic_init(&b->refs, 1);
+    b->len = len;
+    memcpy(b->data, data, len);
+    return b;
+}
+
+OutBuf *outbuf_ref(OutBuf *b)
+{
+    atomic_fetch_add_explicit(&b->refs, 1, memory_order_relaxed);
+    return b;
+}
+
+void outbuf_unref(OutBuf *b)
+{
+    if (b && atomic_fetch_sub_explicit(&b->refs, 1, memory_order_acq_rel) == 1)
+        free(b);
+}
+
+void outq_clear(OutQueue *q)
+{
+    for (size_t i = 0; i < q->count; i++)
+        outbuf_unref(q->items[(q->head + i) % q->cap].buf);
+    q->head = q->count = q->bytes = 0;
+}
+
+void outq_free(OutQueue *q)
+{
+    outq_clear(q);
+    free(q->items);
+    q->items = NULL;
+    q->cap = 0;
+}
+
+static bool outq_grow(OutQueue *q)
+{
+    size_t cap = q->cap ? q->cap * 2 : OUTQ_MIN_CAP;
+    OutRef *items = malloc(cap * sizeof(*items));
+    if (!items)
+        return false;
+
+    // Unwrap the ring so the new one starts at 0
+    for (size_t i = 0; i < q->count; i++)
+        items[i] = q->items[(q->head + i) % q->cap];
+    free(q->items);
+    q->items = items;
+    q->cap = cap;
+    q->head = 0;
+    return true;
+}
+
+bool outq_push(OutQueue *q, OutBuf *b, size_t off)
+{
+    if (off >= b->len)
+        return true;
+    if (q->count == q->cap && !outq_grow(q))
+        return false;
+
+    q->items[(q->head + q->count) % q->cap] = (OutRef){ outbuf_ref(b), off };
+    q->count++;
+    q->bytes += b->len - off;
+    return true;
+}
+
+size_t outq_trim(OutQueue *q)
+{
+    size_t keep = q->count > 0 && q->items[q->head].off > 0 ? 1 : 0;
+    size_t dropped = 0;
+
+    for (size_t i = keep; i < q->count; i++) {
+        OutRef *ref = &q->items[(q->head + i) % q->cap];
+        dropped += ref->buf->len - ref->off;
+        outbuf_unref(ref->buf);
+    }
+    q->count = keep;
+    q->bytes -= dropped;
+    return dropped;
+}
+
+// Releases n sent bytes from the head
+static void outq_advance(OutQueue *q, size_t n)
+{
+    q->bytes -= n;
+    while (n > 0) {
+        OutRef *ref = &q->items[q->head];
+        size_t left = ref->buf->len - ref->off;
+        if (n < left) {
+            ref->off += n;
+            return;
+        }
+        n -= left;
+        outbuf_unref(ref->buf);
+        q->head = (q->head + 1) % q->cap;
+        q->count--;
+    }
+}
+
+long outq_send(OutQueue *q, int fd)
+{
+    size_t count = q->count < OUTQ_IOV ? q->count : OUTQ_IOV;
+    long n;
+
+    if (count == 0)
+        return 0;
+
+#ifdef _WIN32
+    WSABUF bufs[OUTQ_IOV];
+    DWORD sent = 0;
+    for (size_t i = 0; i < count; i++) {
+        const OutRef *ref = &q->items[(q->head + i) % q->cap];
+        bufs[i].buf = ref->buf->data + ref->off;
+        bufs[i].len = (ULONG)(ref->buf->len - ref->off);
+    }
+    n = WSASend(fd, bufs, (DWORD)count, &sent, 0, NULL, NULL) == 0 ? (long)sent : -1;
+    if (n < 0 && WSAGetLastError() == WSAEWOULDBLOCK)
+        errno = EWOULDBLOCK;
+#else
+    struct iovec iov[OUTQ_IOV];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    for (size_t i = 0; i < count; i++) {
+        const OutRef *ref = &q->items[(q->head + i) % q->cap];
+        iov[i].iov_base = ref->buf->data + ref->off;
+        iov[i].iov_len = ref->buf->len - ref->off;
+    }
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+    n = (long)sendmsg(fd, &msg, MSG_NOSIGNAL);
+#endif
+
+    if (n > 0)
+        outq_advance(q, (size_t)n);
+    return n;
+}
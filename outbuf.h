@@ -0,0 +1,58 @@
+#ifndef OUTBUF_H
+#define OUTBUF_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Outbound data for non-blocking sockets, queued by reference instead of
+// copied. An OutBuf is an immutable block with a reference count: a room
+// renders an event once and every connection that has to send it queues a
+// pointer to the same block, so fanning one event out to hundreds of
+// watchers costs a pointer per watcher plus the bytes the kernel copies.
+// The count is atomic because a few blocks (the prompts) are shared by
+// every reactor thread; everything else is touched by one thread only.
+
+typedef struct {
+    atomic_int refs;
+    size_t len;
+    char data[];
+} OutBuf;
+
+// Copy of data with one reference held by the caller; NULL if out of memory
+OutBuf *outbuf_new(const void *data, size_t len);
+OutBuf *outbuf_ref(OutBuf *b);
+void outbuf_unref(OutBuf *b);
+
+typedef struct {
+    OutBuf *buf;
+    size_t off;         // bytes of buf already sent
+} OutRef;
+
+// FIFO of blocks waiting for one socket, as a ring of references
+typedef struct {
+    OutRef *items;
+    size_t head;
+    size_t count;
+    size_t cap;
+    size_t bytes;       // unsent bytes over all items
+} OutQueue;
+
+void outq_free(OutQueue *q);
+
+// Drops everything queued
+void outq_clear(OutQueue *q);
+
+// Queues b from byte off on, taking a reference of its own; false if out
+// of memory
+bool outq_push(OutQueue *q, OutBuf *b, size_t off);
+
+// Drops every block that has not started to go out, keeping a partly sent
+// head so the peer never gets half a message. Returns the bytes dropped.
+size_t outq_trim(OutQueue *q);
+
+// One gathered send of the blocks at the head of the queue, releasing the
+// ones that went out whole. Returns the bytes sent or -1 with errno set.
+long outq_send(OutQueue *q, int fd);
+
+#endif //OUTBUF_H
@@ -0,0 +1,248 @@
+#include "pool.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <unistd.h>
+#endif
+
+typedef struct {
+    PoolTaskFn fn;
+    void *arg;
+} Task;
+
+// Growable ring: the owner pushes and pops at the bottom, thieves take
+// from the top.
+typedef struct {
+    pthread_mutex_t lock;
+    Task *tasks;
+    size_t cap;
+    size_t top;
+    size_t bottom;
+} Deque;
+
+typedef struct {
+    WorkPool *pool;
+    int index;
+    pthread_t thread;
+} Worker;
+
+struct WorkPool {
+    int nthreads;
+    Deque *deques;
+    Worker *workers;
+
+    atomic_uint next_deque;  // round-robin target for pool_submit
+    atomic_int queued;       // tasks sitting in some deque
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_cv;  // signalled when a task is queued or on stop
+    pthread_cond_t idle_cv;  // signalled when unfinished drops to 0
+    long unfinished;         // submitted but not yet completed
+    bool stop;
+};
+
+int pool_cpu_count(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return (int)si.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#endif
+}
+
+static void deque_push(Deque *d, Task t)
+{
+    pthread_mutex_lock(&d->lock);
+    if (d->bottom - d->top == d->cap) {
+        size_t cap = d->cap ? d->cap * 2 : 64;
+        Task *grown = malloc(cap * sizeof(Task));
+        if (!grown) {
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+        for (size_t i = d->top; i < d->bottom; i++)
+            grown[i - d->top] = d->tasks[i % d->cap];
+        free(d->tasks);
+        d->bottom -= d->top;
+        d->top = 0;
+        d->tasks = grown;
+        d->cap = cap;
+    }
+    d->tasks[d->bottom++ % d->cap] = t;
+    pthread_mutex_unlock(&d->lock);
+}
+
+static bool deque_pop_bottom(Deque *d, Task *out)
+{
+    bool ok = false;
+    pthread_mutex_lock(&d->lock);
+    if (d->bottom > d->top) {
+        *out = d->tasks[--d->bottom % d->cap];
+        ok = true;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return ok;
+}
+
+static bool deque_steal_top(Deque *d, Task *out)
+{
+    bool ok = false;
+    if (pthread_mutex_trylock(&d->lock) != 0)
+        return false; // busy: try another victim instead of waiting
+    if (d->bottom > d->top) {
+        *out = d->tasks[d->top++ % d->cap];
+        ok = true;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return ok;
+}
+
+static bool find_task(WorkPool *p, int self, Task *out)
+{
+    if (deque_pop_bottom(&p->deques[self], out))
+        return true;
+
+    for (int i = 1; i < p->nthreads; i++) {
+        if (deque_steal_top(&p->deques[(self + i) % p->nthreads], out))
+            return true;
+    }
+    return false;
+}
+
+static void *worker_main(void *arg)
+{
+    Worker *w = arg;
+    WorkPool *p = w->pool;
+
+    for (;;) {
+        Task t;
+        if (find_task(p, w->index, &t)) {
+            atomic_fetch_sub(&p->queued, 1);
+            t.fn(t.arg);
+
+            pthread_mutex_lock(&p->lock);
+            if (--p->unfinished == 0)
+                pthread_cond_broadcast(&p->idle_cv);
+            pthread_mutex_unlock(&p->lock);
+            continue;
+        }
+
+        pthread_mutex_lock(&p->lock);
+        while (atomic_load(&p->queued) == 0 && !p->stop)
+            pthread_cond_wait(&p->work_cv, &p->lock);
+        bool done = p->stop && atomic_load(&p->queued) == 0;
+        pthread_mutex_unlock(&p->lock);
+
+        if (done)
+            break;
+    }
+    return NULL;
+}
+
+WorkPool *pool_create(int nthreads)
+{
+    if (nthreads <= 0)
+        nthreads = pool_cpu_count();
+
+    WorkPool *p = calloc(1, sizeof(*p));
+    if (!p)
+        return NULL;
+
+    p->nthreads = nthreads;
+    p->deques = calloc((size_t)nthreads, sizeof(Deque));
+    p->workers = calloc((size_t)nthreads, sizeof(Worker));
+    if (!p->deques || !p->workers) {
+        free(p->deques);
+        free(p->workers);
+        free(p);
+        return NULL;
+    }
+
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->work_cv, NULL);
+    pthread_cond_init(&p->idle_cv, NULL);
+    atomic_init(&p->next_deque, 0);
+    atomic_init(&p->queued, 0);
+
+    for (int i = 0; i < nthreads; i++)
+        pthread_mutex_init(&p->deques[i].lock, NULL);
+
+    for (int i = 0; i < nthreads; i++) {
+        p->workers[i].pool = p;
+        p->workers[i].index = i;
+        if (pthread_create(&p->workers[i].thread, NULL, worker_main, &p->workers[i]) != 0) {
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    return p;
+}
+
+int pool_threads(const WorkPool *p)
+{
+    return p->nthreads;
+}
+
+void pool_submit(WorkPool *p, PoolTaskFn fn, void *arg)
+{
+    Task t = { fn, arg };
+    unsigned i = atomic_fetch_add(&p->next_deque, 1) % (unsigned)p->nthreads;
+
+    pthread_mutex_lock(&p->lock);
+    p->unfinished++;
+    pthread_mutex_unlock(&p->lock);
+
+    deque_push(&p->deques[i], t);
+    atomic_fetch_add(&p->queued, 1);
+
+    pthread_mutex_lock(&p->lock);
+    pthread_cond_signal(&p->work_cv);
+    pthread_mutex_unlock(&p->lock);
+}
+
+void pool_wait(WorkPool *p)
+{
+    pthread_mutex_lock(&p->lock);
+    while (p->unfinished > 0)
+        pthread_cond_wait(&p->idle_cv, &p->lock);
+    pthread_mutex_unlock(&p->lock);
+}
+
+void pool_destroy(WorkPool *p)
+{
+    if (!p)
+        return;
+
+    pool_wait(p);
+
+    pthread_mutex_lock(&p->lock);
+    p->stop = true;
+    pthread_cond_broadcast(&p->work_cv);
+    pthread_mutex_unlock(&p->lock);
+
+    for (int i = 0; i < p->nthreads; i++)
+        pthread_join(p->workers[i].thread, NULL);
+
+    for (int i = 0; i < p->nthreads; i++) {
+        pthread_mutex_destroy(&p->deques[i].lock);
+        free(p->deques[i].tasks);
+    }
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->work_cv);
+    pthread_cond_destroy(&p->idle_cv);
+
+    free(p->deques);
+    free(p->workers);
+    free(p);
+}
@@ -0,0 +1,26 @@
+#ifndef POOL_H
+#define POOL_H
+
+// Fixed set of worker threads with one task deque each. A worker pops its
+// own deque newest-first and, once that is empty, steals the oldest task
+// from another worker, so uneven task costs even out across threads.
+
+typedef void (*PoolTaskFn)(void *arg);
+
+typedef struct WorkPool WorkPool;
+
+// nthreads <= 0 means one worker per online CPU
+WorkPool *pool_create(int nthreads);
+int pool_threads(const WorkPool *p);
+
+void pool_submit(WorkPool *p, PoolTaskFn fn, void *arg);
+
+// Blocks until every task submitted so far has finished
+void pool_wait(WorkPool *p);
+
+// Waits for outstanding tasks, then joins the workers
+void pool_destroy(WorkPool *p);
+
+int pool_cpu_count(void);
+
+#endif //POOL_H
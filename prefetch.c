@@ -0,0 +1,177 @@
+#include "prefetch.h"
+#include "generator.h"
+#include "solver.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+#endif
+
+// How long the producer naps when the ring is full
+#define FULL_BACKOFF_MS 2
+
+// Bounded queue with a sequence number per slot (Vyukov style): a slot is
+// free for position pos when seq == pos and holds data when seq == pos + 1.
+// The producer never blocks takers and takers never lock.
+typedef struct {
+    atomic_size_t seq;
+    Board puzzle;
+    Board solution;
+} Slot;
+
+struct Prefetcher {
+    Slot *slots;
+    size_t mask;
+    atomic_size_t head;     // next position to fill (producer only)
+    atomic_size_t tail;     // next position to take
+    atomic_bool stop;
+
+    PuzzleSource source;
+    void *arg;
+    pthread_t thread;
+};
+
+static void sleep_ms(int ms)
+{
+#ifdef _WIN32
+    Sleep((DWORD)ms);
+#else
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+#endif
+}
+
+static bool try_put(Prefetcher *pf, const Board puzzle, const Board solution)
+{
+    size_t pos = atomic_load_explicit(&pf->head, memory_order_relaxed);
+    Slot *slot = &pf->slots[pos & pf->mask];
+
+    if (atomic_load_explicit(&slot->seq, memory_order_acquire) != pos)
+        return false; // full: slot not taken yet
+
+    memcpy(slot->puzzle, puzzle, sizeof(Board));
+    memcpy(slot->solution, solution, sizeof(Board));
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+    atomic_store_explicit(&pf->head, pos + 1, memory_order_relaxed);
+    return true;
+}
+
+bool prefetch_take(Prefetcher *pf, Board puzzle, Board solution)
+{
+    size_t pos = atomic_load_explicit(&pf->tail, memory_order_relaxed);
+
+    for (;;) {
+        Slot *slot = &pf->slots[pos & pf->mask];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&pf->tail, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                memcpy(puzzle, slot->puzzle, sizeof(Board));
+                memcpy(solution, slot->solution, sizeof(Board));
+                atomic_store_explicit(&slot->seq, pos + pf->mask + 1, memory_order_release);
+                return true;
+            }
+            // pos was reloaded by the failed exchange
+        } else if (diff < 0) {
+            return false; // empty
+        } else {
+            pos = atomic_load_explicit(&pf->tail, memory_order_relaxed);
+        }
+    }
+}
+
+static void *producer_main(void *arg)
+{
+    Prefetcher *pf = arg;
+
+    while (!atomic_load(&pf->stop)) {
+        Board puzzle, solution;
+
+        if (!pf->source(pf->arg, puzzle, solution))
+            continue;
+        if (!solver_verify_pair(puzzle, solution)) {
+            fprintf(stderr, "prefetch: skipping puzzle that is not unique or disagrees with its solution\n");
+            continue;
+        }
+
+        while (!try_put(pf, puzzle, solution)) {
+            if (atomic_load(&pf->stop))
+                return NULL;
+            sleep_ms(FULL_BACKOFF_MS);
+        }
+    }
+    return NULL;
+}
+
+Prefetcher *prefetch_start(int capacity, PuzzleSource source, void *arg)
+{
+    size_t cap = 2;
+    while (cap < (size_t)capacity)
+        cap <<= 1;
+
+    Prefetcher *pf = calloc(1, sizeof(*pf));
+    if (!pf)
+        return NULL;
+    pf->slots = calloc(cap, sizeof(Slot));
+    if (!pf->slots) {
+        free(pf);
+        return NULL;
+    }
+
+    pf->mask = cap - 1;
+    pf->source = source;
+    pf->arg = arg;
+    for (size_t i = 0; i < cap; i++)
+        atomic_init(&pf->slots[i].seq, i);
+    atomic_init(&pf->head, 0);
+    atomic_init(&pf->tail, 0);
+    atomic_init(&pf->stop, false);
+
+    if (pthread_create(&pf->thread, NULL, producer_main, pf) != 0) {
+        free(pf->slots);
+        free(pf);
+        return NULL;
+    }
+    return pf;
+}
+
+void prefetch_stop(Prefetcher *pf)
+{
+    if (!pf)
+        return;
+    atomic_store(&pf->stop, true);
+    pthread_join(pf->thread, NULL);
+    free(pf->slots);
+    free(pf);
+}
+
+bool prefetch_source_generator(void *arg, Board puzzle, Board solution)
+{
+    (void)arg;
+    generate_puzzle(puzzle, solution);
+    return true;
+}
+
+bool prefetch_source_difficulty(void *arg, Board puzzle, Board solution)
+{
+    // Each prefetcher has its own producer thread, so its own generator
+    static _Thread_local GenRng rng;
+    static _Thread_local bool seeded;
+
+    if (!seeded) {
+        gen_rng_seed(&rng, (uint64_t)time(NULL) ^ (uint64_t)(uintptr_t)&rng);
+        seeded = true;
+    }
+    generate_random_puzzle(puzzle, solution, *(const Difficulty *)arg, 0, &rng);
+    return true;
+}
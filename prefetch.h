@@ -0,0 +1,31 @@
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include "board.h"
+#include <stdbool.h>
+
+// Keeps a bounded ring of ready puzzle/solution pairs filled from a
+// background thread. Every pair is checked with solver_verify_pair()
+// before it is queued, so takers get a unique, verified puzzle without
+// solving anything themselves.
+
+// Produces one candidate pair; returning false skips the attempt
+typedef bool (*PuzzleSource)(void *arg, Board puzzle, Board solution);
+
+typedef struct Prefetcher Prefetcher;
+
+// capacity is rounded up to a power of two
+Prefetcher *prefetch_start(int capacity, PuzzleSource source, void *arg);
+
+// Lock-free; returns false if the ring is currently empty
+bool prefetch_take(Prefetcher *pf, Board puzzle, Board solution);
+
+void prefetch_stop(Prefetcher *pf);
+
+// PuzzleSource that calls generate_puzzle()
+bool prefetch_source_generator(void *arg, Board puzzle, Board solution);
+
+// PuzzleSource that generates a fresh puzzle at the Difficulty arg points to
+bool prefetch_source_difficulty(void *arg, Board puzzle, Board solution);
+
+#endif //PREFETCH_H
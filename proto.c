@@ -0,0 +1,137 @@
+#include "proto.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const char *const mode_names[PROTO_MODES] = {
+    [PROTO_TEXT]   = "text",
+    [PROTO_DELTA]  = "delta",
+    [PROTO_BINARY] = "binary",
+};
+
+static const struct {
+    const char *name;
+    const char *text;
+} notes[NOTE_COUNT] = {
+    [NOTE_CORRECT]        = { "correct",      "Correct! Player %d gains a point.\n" },
+    [NOTE_WRONG]          = { "wrong",        "Wrong number. Board stays the same.\n" },
+    [NOTE_BAD_FORMAT]     = { "format",       "Invalid input. Use format like A7 4.\n" },
+    [NOTE_OUT_OF_RANGE]   = { "range",        "Move out of range.\n" },
+    [NOTE_FIXED_CELL]     = { "given",        "Cannot change an original puzzle clue.\n" },
+    [NOTE_ALREADY_FILLED] = { "filled",       "That cell is already filled.\n" },
+    [NOTE_BREAKS_RULES]   = { "rules",        "That move breaks Sudoku rules.\n" },
+    [NOTE_TIMEOUT]        = { "timeout",      "Time up! No move registered. Turn lost.\n" },
+    [NOTE_MENU_INVALID]   = { "menu-invalid", "Invalid input.\n" },
+    [NOTE_MENU_CHOICE]    = { "menu-choice",  "Please enter R, N, or Q.\n" },
+    [NOTE_REPLAY]         = { "replay",       "\nReplaying the same exercise...\n" },
+    [NOTE_NEXT]           = { "next",         "\nLoading next exercise...\n" },
+    [NOTE_BYE]            = { "bye",          "\nQuitting the game. Bye!\n" },
+    [NOTE_MENU_TIMEOUT]   = { "menu-timeout", "\nNo choice made in time. Ending game.\n" },
+};
+
+const char *proto_mode_name(ProtoMode mode)
+{
+    return mode < PROTO_MODES ? mode_names[mode] : "?";
+}
+
+bool proto_mode_from_name(const char *name, ProtoMode *out)
+{
+    for (int i = 0; i < PROTO_MODES; i++) {
+        if (strcmp(name, mode_names[i]) == 0) {
+            *out = (ProtoMode)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *proto_note_name(ProtoNote note)
+{
+    return note < NOTE_COUNT ? notes[note].name : "?";
+}
+
+bool proto_note_from_name(const char *name, ProtoNote *out)
+{
+    for (int i = 0; i < NOTE_COUNT; i++) {
+        if (strcmp(name, notes[i].name) == 0) {
+            *out = (ProtoNote)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *proto_note_text(ProtoNote note)
+{
+    return note < NOTE_COUNT ? notes[note].text : "";
+}
+
+const char *proto_winner_text(int score1, int score2)
+{
+    if (score1 > score2)
+        return "Winner: Player 1!\n";
+    if (score2 > score1)
+        return "Winner: Player 2!\n";
+    return "It's a tie!\n";
+}
+
+bool proto_parse_move(const char *line, int *row, int *col, int *value)
+{
+    char rowChar;
+    int c, v;
+
+    if (sscanf(line, " %c%d %d", &rowChar, &c, &v) != 3) {
+        return false;
+    }
+    if (rowChar >= 'a' && rowChar <= 'z')
+        rowChar = (char)(rowChar - 'a' + 'A');
+    if (rowChar < 'A' || rowChar > 'I') return false;
+    if (c < 1 || c > 9) return false;
+    if (v < 1 || v > 9) return false;
+
+    *row   = rowChar - 'A';
+    *col   = c - 1;
+    *value = v;
+
+    return true;
+}
+
+size_t proto_encode(uint8_t *out, ProtoMsgType type, const uint8_t *payload, size_t len)
+{
+    out[0] = (uint8_t)type;
+    out[1] = (uint8_t)(len >> 8);
+    out[2] = (uint8_t)len;
+    if (len)
+        memcpy(out + PROTO_HEADER, payload, len);
+    return PROTO_HEADER + len;
+}
+
+long proto_frame_size(const uint8_t *buf, size_t avail)
+{
+    if (avail < PROTO_HEADER)
+        return 0;
+
+    size_t len = ((size_t)buf[1] << 8) | buf[2];
+    if (len > PROTO_MAX_PAYLOAD)
+        return -1;
+    if (avail < PROTO_HEADER + len)
+        return 0;
+    return (long)(PROTO_HEADER + len);
+}
+
+void proto_pack_board(const Board b, uint8_t out[PROTO_BOARD_BYTES])
+{
+    memset(out, 0, PROTO_BOARD_BYTES);
+    for (int i = 0; i < BOARD_LINE_LEN; i++) {
+        uint8_t v = (uint8_t)(b[i / BOARDSIZE][i % BOARDSIZE] & 0xF);
+        out[i / 2] |= (i & 1) ? v : (uint8_t)(v << 4);
+    }
+}
+
+void proto_unpack_board(const uint8_t in[PROTO_BOARD_BYTES], Board b)
+{
+    for (int i = 0; i < BOARD_LINE_LEN; i++) {
+        uint8_t byte = in[i / 2];
+        b[i / BOARDSIZE][i % BOARDSIZE] = (i & 1) ? (byte & 0xF) : (byte >> 4);
+    }
+}
@@ -0,0 +1,167 @@
+#ifndef PROTO_H
+#define PROTO_H
+
+#include "board.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Wire protocols spoken between server and clients.
+//
+// text:  the original human-readable stream. The server renders everything,
+//        including the full board every turn; clients just print it.
+// delta: one short line per game event. The board goes out once per
+//        exercise and after that only the changed cells, and the client
+//        renders the same text locally:
+//
+//          WELCOME mode=delta version=N
+//                                 reply to HELLO mode=delta
+//          YOU_ARE_PLAYER n
+//          JOINED n               player n connected
+//          RULES s                game starts, s seconds per turn
+//          PUZZLE <81 digits>     new or replayed exercise, scores reset
+//          TURN n                 player n is to move
+//          SET A7=4               cell placed
+//          SCORE n s              player n now has s points
+//          NOTE name              outcome message, see ProtoNote
+//          END                    exercise complete
+//          MENU                   player 1 chooses R/N/Q
+//          LEFT n                 player n disconnected, game over
+//          YOUR_MOVE / YOUR_MENU  same as in text mode
+//          SPECTATING id          watching room id; the PUZZLE, SCORE and
+//                                 TURN or MENU lines after it catch up
+//          NO_GAME                nothing to watch, connection closes
+//
+// binary: the delta events as length-prefixed frames, for bots and load
+//         tools: a 1-byte ProtoMsgType, a 2-byte big-endian payload length,
+//         then the payload. Nothing has to be scanned for, and a reader
+//         always knows how many bytes the next message needs.
+//
+// A client picks a mode by sending "HELLO mode=NAME [version=N]
+// [difficulty=LEVEL] [turn=SECONDS]" right after connecting, and the server
+// answers "WELCOME mode=NAME version=N difficulty=LEVEL" with the mode,
+// protocol version and matchmaking level it will use. Clients that say
+// nothing get text mode and any difficulty. turn= asks for a turn length
+// other than the server's; player 1's wish comes first, and RULES gives
+// the length in force. In binary mode everything after the WELCOME line,
+// in both directions, is frames.
+//
+// Adding "role=spectate [room=ID]" to HELLO watches a running game instead
+// of joining the lobby: the newest one if no room is named. WELCOME then
+// ends in " role=spectate". Spectators get every message the players see
+// except the prompts, in their own protocol, and anything they send is
+// ignored.
+
+typedef enum {
+    PROTO_TEXT,
+    PROTO_DELTA,
+    PROTO_BINARY,
+    PROTO_MODES
+} ProtoMode;
+
+const char *proto_mode_name(ProtoMode mode);
+bool proto_mode_from_name(const char *name, ProtoMode *out);
+
+typedef enum {
+    NOTE_CORRECT,
+    NOTE_WRONG,
+    NOTE_BAD_FORMAT,
+    NOTE_OUT_OF_RANGE,
+    NOTE_FIXED_CELL,
+    NOTE_ALREADY_FILLED,
+    NOTE_BREAKS_RULES,
+    NOTE_TIMEOUT,
+    NOTE_MENU_INVALID,
+    NOTE_MENU_CHOICE,
+    NOTE_REPLAY,
+    NOTE_NEXT,
+    NOTE_BYE,
+    NOTE_MENU_TIMEOUT,
+    NOTE_COUNT
+} ProtoNote;
+
+const char *proto_note_name(ProtoNote note);
+bool proto_note_from_name(const char *name, ProtoNote *out);
+
+// printf format of the note's text; takes the player number (1 or 2) of
+// the player whose turn it was
+const char *proto_note_text(ProtoNote note);
+
+// Text both the server (text mode) and local renderers print
+#define PROTO_TEXT_JOINED "PLAYER %d connected.\n"
+#define PROTO_TEXT_INTRO                                                    \
+    "Two-player Sudoku.\n"                                                  \
+    "Input format: A7 4 (row letter, column number, value).\n"              \
+    "Each turn: %d seconds to enter ONE move.\n"                            \
+    "Correct number = +1 point. Wrong number = no change, turn passes.\n"   \
+    "No input / too slow = turn lost.\n"
+#define PROTO_TEXT_TURN                                                     \
+    "\n==== Player %d's TURN ====\n"                                        \
+    "\nCurrent scores:\n"                                                   \
+    "  Player 1: %d\n"                                                      \
+    "  Player 2: %d\n"
+#define PROTO_TEXT_COMPLETE "\n=== EXERCISE COMPLETE ===\n"
+#define PROTO_TEXT_SCORES                                                   \
+    "Scores for this exercise:\n"                                           \
+    "Player 1: %d\n"                                                        \
+    "Player 2: %d\n"
+#define PROTO_TEXT_MENU                                                     \
+    "\nWhat do you want to do now?\n"                                       \
+    "  R - Replay the SAME exercise\n"                                      \
+    "  N - Next exercise (new puzzle)\n"                                    \
+    "  Q - Quit\n"                                                          \
+    "Player 1, enter choice (R/N/Q):\n"
+#define PROTO_TEXT_LEFT "\n*** Player %d disconnected. Ending game for all players. ***\n"
+#define PROTO_TEXT_LEFT_MENU "\n*** Player 1 disconnected during menu. Ending game. ***\n"
+
+// "Winner: Player 1!\n", "Winner: Player 2!\n" or "It's a tie!\n"
+const char *proto_winner_text(int score1, int score2);
+
+// Parses a move typed as "A7 4" (row letter in either case, column, value)
+// into 0-based row and column and the value. False if it is not one.
+bool proto_parse_move(const char *line, int *row, int *col, int *value);
+
+// ---- binary frames ----
+
+#define PROTO_VERSION     1
+#define PROTO_HEADER      3     // type + 16-bit length
+#define PROTO_MAX_PAYLOAD 64    // longer frames are a protocol error
+#define PROTO_BOARD_BYTES ((BOARD_LINE_LEN + 1) / 2)
+
+typedef enum {
+    // server -> client        payload
+    MSG_PLAYER    = 1,      // u8 player number
+    MSG_JOINED    = 2,      // u8 player number
+    MSG_RULES     = 3,      // u16 seconds per turn
+    MSG_PUZZLE    = 4,      // PROTO_BOARD_BYTES packed cells; scores reset
+    MSG_TURN      = 5,      // u8 player number
+    MSG_SET       = 6,      // u8 cell (row * 9 + col), u8 value
+    MSG_SCORE     = 7,      // u8 player number, u16 score
+    MSG_NOTE      = 8,      // u8 ProtoNote
+    MSG_END       = 9,      // -
+    MSG_MENU      = 10,     // -
+    MSG_LEFT      = 11,     // u8 player number
+    MSG_YOUR_MOVE = 12,     // -
+    MSG_YOUR_MENU = 13,     // -
+    MSG_SPECTATING = 14,    // u32 room id
+    MSG_NO_GAME   = 15,     // -
+
+    // client -> server
+    MSG_MOVE      = 32,     // u8 cell, u8 value
+    MSG_CHOICE    = 33      // u8 'R', 'N' or 'Q'
+} ProtoMsgType;
+
+// Writes one frame to out, which needs PROTO_HEADER + len bytes. Returns
+// the frame size.
+size_t proto_encode(uint8_t *out, ProtoMsgType type, const uint8_t *payload, size_t len);
+
+// Size of the frame at the start of buf: 0 if more bytes are needed to
+// know or to hold all of it, -1 if it is longer than PROTO_MAX_PAYLOAD
+long proto_frame_size(const uint8_t *buf, size_t avail);
+
+// Two cells per byte, high nibble first
+void proto_pack_board(const Board b, uint8_t out[PROTO_BOARD_BYTES]);
+void proto_unpack_board(const uint8_t in[PROTO_BOARD_BYTES], Board b);
+
+#endif //PROTO_H
@@ -0,0 +1,226 @@
+#include "puzzledb.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+    #include <io.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+
+#define INDEX_MAGIC   0x5844494B4F445553ull  // "SUDOKIDX"
+#define INDEX_VERSION 1
+
+// Sidecar layout: this header followed by `count` uint64 offsets
+typedef struct {
+    uint64_t magic;
+    uint64_t version;
+    uint64_t file_size;
+    uint64_t file_mtime;
+    uint64_t count;
+} IndexHeader;
+
+// Maps a whole file read-only. On platforms without mmap the file is read
+// into memory instead, which keeps the same interface.
+static void *map_file(const char *path, size_t *size_out, struct stat *st)
+{
+#ifdef _WIN32
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return NULL;
+    if (fstat(_fileno(f), st) != 0 || st->st_size <= 0) {
+        fclose(f);
+        return NULL;
+    }
+    size_t size = (size_t)st->st_size;
+    void *p = malloc(size);
+    if (p && fread(p, 1, size, f) != size) {
+        free(p);
+        p = NULL;
+    }
+    fclose(f);
+    *size_out = size;
+    return p;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, st) != 0 || st->st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+    size_t size = (size_t)st->st_size;
+    void *p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return NULL;
+    *size_out = size;
+    return p;
+#endif
+}
+
+static void unmap_file(void *p, size_t size)
+{
+    if (!p)
+        return;
+#ifdef _WIN32
+    (void)size;
+    free(p);
+#else
+    munmap(p, size);
+#endif
+}
+
+static bool is_cells(const char *p, const char *end)
+{
+    if (end - p < BOARD_LINE_LEN)
+        return false;
+    for (int i = 0; i < BOARD_LINE_LEN; i++) {
+        if ((p[i] < '0' || p[i] > '9') && p[i] != '.')
+            return false;
+    }
+    return true;
+}
+
+// A usable row is 81 cells, a comma and 81 cells
+static bool is_row(const char *line, const char *end)
+{
+    return is_cells(line, end) &&
+           end - line > BOARD_LINE_LEN && line[BOARD_LINE_LEN] == ',' &&
+           is_cells(line + BOARD_LINE_LEN + 1, end);
+}
+
+static bool build_offsets(PuzzleDb *db)
+{
+    size_t cap = db->size / (2 * BOARD_LINE_LEN + 2) + 1;
+    uint64_t *offsets = malloc(cap * sizeof(uint64_t));
+    if (!offsets)
+        return false;
+
+    size_t count = 0;
+    const char *p = db->data;
+    const char *end = db->data + db->size;
+
+    while (p < end) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        const char *line_end = nl ? nl : end;
+
+        if (is_row(p, line_end)) {
+            if (count == cap) {
+                cap *= 2;
+                uint64_t *grown = realloc(offsets, cap * sizeof(uint64_t));
+                if (!grown) {
+                    free(offsets);
+                    return false;
+                }
+                offsets = grown;
+            }
+            offsets[count++] = (uint64_t)(p - db->data);
+        }
+        p = line_end + 1;
+    }
+
+    db->owned_offsets = offsets;
+    db->offsets = offsets;
+    db->count = count;
+    return true;
+}
+
+static bool load_index(PuzzleDb *db, const char *idx_path, const struct stat *st)
+{
+    struct stat ist;
+    size_t size = 0;
+    void *map = map_file(idx_path, &size, &ist);
+    if (!map)
+        return false;
+
+    const IndexHeader *h = map;
+    bool ok = size >= sizeof(*h) &&
+              h->magic == INDEX_MAGIC && h->version == INDEX_VERSION &&
+              h->file_size == (uint64_t)st->st_size &&
+              h->file_mtime == (uint64_t)st->st_mtime &&
+              size == sizeof(*h) + h->count * sizeof(uint64_t);
+
+    if (!ok) {
+        unmap_file(map, size);
+        return false;
+    }
+
+    db->index_map = map;
+    db->index_map_size = size;
+    db->offsets = (const uint64_t *)(h + 1);
+    db->count = (size_t)h->count;
+    return true;
+}
+
+// Best effort: a read-only directory just means rebuilding next time
+static void save_index(const PuzzleDb *db, const char *idx_path, const struct stat *st)
+{
+    IndexHeader h = {
+        INDEX_MAGIC, INDEX_VERSION,
+        (uint64_t)st->st_size, (uint64_t)st->st_mtime, (uint64_t)db->count
+    };
+
+    char tmp_path[1024];
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", idx_path) >= (int)sizeof(tmp_path))
+        return;
+
+    FILE *f = fopen(tmp_path, "wb");
+    if (!f)
+        return;
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+              fwrite(db->offsets, sizeof(uint64_t), db->count, f) == db->count;
+    ok = fclose(f) == 0 && ok;
+
+    if (!ok || rename(tmp_path, idx_path) != 0)
+        remove(tmp_path);
+}
+
+bool puzzledb_open(PuzzleDb *db, const char *path)
+{
+    memset(db, 0, sizeof(*db));
+
+    struct stat st;
+    db->map = map_file(path, &db->map_size, &st);
+    if (!db->map)
+        return false;
+    db->data = db->map;
+    db->size = db->map_size;
+
+    char idx_path[1024];
+    bool cacheable = snprintf(idx_path, sizeof(idx_path), "%s.idx", path) < (int)sizeof(idx_path);
+
+    if (!cacheable || !load_index(db, idx_path, &st)) {
+        if (!build_offsets(db)) {
+            puzzledb_close(db);
+            return false;
+        }
+        if (cacheable)
+            save_index(db, idx_path, &st);
+    }
+
+    return true;
+}
+
+void puzzledb_close(PuzzleDb *db)
+{
+    unmap_file(db->map, db->map_size);
+    unmap_file(db->index_map, db->index_map_size);
+    free(db->owned_offsets);
+    memset(db, 0, sizeof(*db));
+}
+
+bool puzzledb_get(const PuzzleDb *db, size_t index, Board puzzle, Board solution)
+{
+    if (index >= db->count || db->offsets[index] + 2 * BOARD_LINE_LEN + 1 > db->size)
+        return false;
+
+    const char *row = db->data + db->offsets[index];
+    return board_from_line(puzzle, row) &&
+           board_from_line(solution, row + BOARD_LINE_LEN + 1);
+}
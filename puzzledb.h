@@ -0,0 +1,33 @@
+#ifndef PUZZLEDB_H
+#define PUZZLEDB_H
+
+#include "board.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A puzzle file (sudoku.csv format) mapped into memory with the byte offset
+// of every valid "puzzle,solution" row, so fetching row i is one lookup.
+// The offsets are cached next to the file in "<path>.idx" and rebuilt when
+// the file's size or modification time no longer match.
+typedef struct {
+    const char *data;
+    size_t size;
+    const uint64_t *offsets;
+    size_t count;
+
+    // Backing storage, released by puzzledb_close()
+    void *map;
+    size_t map_size;
+    void *index_map;
+    size_t index_map_size;
+    uint64_t *owned_offsets;
+} PuzzleDb;
+
+bool puzzledb_open(PuzzleDb *db, const char *path);
+void puzzledb_close(PuzzleDb *db);
+
+// Decodes row `index` (0-based, header excluded)
+bool puzzledb_get(const PuzzleDb *db, size_t index, Board puzzle, Board solution);
+
+#endif //PUZZLEDB_H
@@ -0,0 +1,633 @@
+#include "runner.h"
+#include "board.h"
+#include "solver.h"
+#include "batch.h"
+#include "pool.h"
+#include "generator.h"
+#include "timeutil.h"
+
+#include <ctype.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+// Puzzles flow reader -> worker pool -> writer in chunks. The reader (the
+// calling thread) numbers each chunk and hands it to the pool; the writer
+// thread emits chunks strictly by number, so output keeps input order no
+// matter which worker finishes first. At most `window` chunks are in
+// flight, which bounds memory on arbitrarily long inputs.
+
+#define CHUNK_PUZZLES 256
+#define LINE_MAX_LEN  1024
+
+// Heaviest puzzles listed in the --stats summary
+#define TOP_PUZZLES 5
+
+// Puzzles generated per pool task
+#define GEN_TASK_PUZZLES 64
+
+typedef enum {
+    ITEM_SOLVED,        // solved, no reference solution to compare with
+    ITEM_OK,            // solved and matches the solutions column
+    ITEM_MISMATCH,      // solved but differs from the solutions column
+    ITEM_UNSOLVABLE,
+    ITEM_NON_UNIQUE,    // audit only: more than one solution
+    ITEM_MALFORMED
+} ItemStatus;
+
+static const char *const item_status_names[] = {
+    [ITEM_SOLVED]     = "solved",
+    [ITEM_OK]         = "ok",
+    [ITEM_MISMATCH]   = "mismatch",
+    [ITEM_UNSOLVABLE] = "unsolvable",
+    [ITEM_NON_UNIQUE] = "non-unique",
+    [ITEM_MALFORMED]  = "malformed"
+};
+
+typedef struct {
+    char puzzle[BOARD_LINE_LEN + 1];
+    char expected[BOARD_LINE_LEN + 1];  // empty if the row has no solution
+    long line_no;
+    ItemStatus status;
+    SolverStats stats;                  // --stats / --trace only
+} Item;
+
+struct Pipeline;
+
+typedef struct {
+    struct Pipeline *pl;
+    long seq;
+    int count;
+    Item items[CHUNK_PUZZLES];
+    Board boards[CHUNK_PUZZLES];   // puzzle in, solution out
+    bool solved[CHUNK_PUZZLES];
+    bool unique[CHUNK_PUZZLES];    // audit only
+} Chunk;
+
+typedef struct Pipeline {
+    // Options
+    bool audit;         // count solutions and report only flagged rows
+    bool use_batch;
+    SolverEngine engine;
+    bool quiet;
+    bool stats;         // per-puzzle solver counters in the output
+    FILE *trace;        // search trace of every puzzle, or NULL
+    FILE *in;
+    FILE *out;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cv;
+    Chunk **slots;      // finished chunks, indexed by seq % window
+    int window;
+    long next_read;     // seq of the next chunk the reader will fill
+    long next_write;    // seq of the next chunk the writer will emit
+    bool eof;
+
+    long line_no;                       // reader thread only
+    long counts[ITEM_MALFORMED + 1];    // writer thread only
+    Item top[TOP_PUZZLES];              // writer thread only, by nodes
+    int ntop;
+} Pipeline;
+
+static void solve_usage(bool audit)
+{
+    if (audit)
+        fprintf(stderr, "Usage: sudoku audit [FILE|-] [--threads N] [--output FILE] [--quiet]\n");
+    else
+        fprintf(stderr,
+                "Usage: sudoku solve [FILE|-] [--threads N] [--engine batch|mrv|dlx|backtrack]\n"
+                "                    [--output FILE] [--quiet] [--stats] [--trace FILE]\n");
+}
+
+// Splits "puzzle,solution[,...]" into an item. Returns false if the
+// puzzle column is not 81 cells, or if a solutions column is there but is
+// not 81 cells either: a truncated solution must not pass as a row that
+// simply has none.
+static bool parse_item(char *line, Item *item)
+{
+    line[strcspn(line, "\r\n")] = '\0';
+
+    char *comma = strchr(line, ',');
+    if (comma)
+        *comma = '\0';
+
+    snprintf(item->puzzle, sizeof(item->puzzle), "%.81s", line);
+    item->expected[0] = '\0';
+
+    Board tmp;
+    if (strlen(line) != BOARD_LINE_LEN || !board_from_line(tmp, line))
+        return false;
+
+    if (comma) {
+        char *sol = comma + 1;
+        sol[strcspn(sol, ",")] = '\0';
+        if (sol[0] == '\0')
+            return true;
+        if (strlen(sol) != BOARD_LINE_LEN || !board_from_line(tmp, sol))
+            return false;
+        memcpy(item->expected, sol, BOARD_LINE_LEN + 1);
+    }
+    return true;
+}
+
+static bool read_line(FILE *in, char *buf, size_t size)
+{
+    if (!fgets(buf, (int)size, in))
+        return false;
+
+    // Drop the rest of an overlong line
+    if (!strchr(buf, '\n')) {
+        int ch;
+        while ((ch = fgetc(in)) != EOF && ch != '\n')
+            ;
+    }
+    return true;
+}
+
+// Fills a chunk from the input; returns the number of puzzles read
+static int read_chunk(Pipeline *pl, Chunk *c)
+{
+    char line[LINE_MAX_LEN];
+    c->count = 0;
+
+    while (c->count < CHUNK_PUZZLES && read_line(pl->in, line, sizeof(line))) {
+        pl->line_no++;
+        if (line[0] == '\n' || line[0] == '\r' || line[0] == '\0')
+            continue;
+
+        Item *item = &c->items[c->count];
+        item->line_no = pl->line_no;
+        // A header row ("quizzes,solutions") is only allowed first. It is
+        // told apart by its name, so a first puzzle whose solution is
+        // broken is still reported rather than taken for a header.
+        if (pl->line_no == 1 && isalpha((unsigned char)line[0]))
+            continue;
+        bool ok = parse_item(line, item);
+
+        item->status = ok ? ITEM_SOLVED : ITEM_MALFORMED;
+        if (ok)
+            board_from_line(c->boards[c->count], item->puzzle);
+        else
+            board_init(c->boards[c->count]); // keeps the batch lanes defined
+        c->count++;
+    }
+    return c->count;
+}
+
+static void solve_chunk(void *arg)
+{
+    Chunk *c = arg;
+    Pipeline *pl = c->pl;
+
+    if (pl->audit) {
+        for (int i = 0; i < c->count; i++) {
+            if (c->items[i].status == ITEM_MALFORMED)
+                continue;
+            int n = solver_count(c->boards[i], 2, c->boards[i]);
+            c->solved[i] = n > 0;
+            c->unique[i] = n == 1;
+        }
+    } else if (pl->use_batch) {
+        solve_batch(c->boards, c->count, c->solved);
+    } else if (pl->stats || pl->trace) {
+        for (int i = 0; i < c->count; i++) {
+            Item *item = &c->items[i];
+            if (item->status == ITEM_MALFORMED) {
+                c->solved[i] = false;
+                continue;
+            }
+            if (pl->trace) {
+                fprintf(pl->trace, "# line %ld %s\n", item->line_no, item->puzzle);
+                solver_set_trace(pl->trace);
+            }
+            c->solved[i] = solve_with_stats(c->boards[i], pl->engine, &item->stats);
+            solver_set_trace(NULL);
+        }
+    } else {
+        for (int i = 0; i < c->count; i++)
+            c->solved[i] = c->items[i].status != ITEM_MALFORMED &&
+                           solve_with(c->boards[i], pl->engine);
+    }
+
+    for (int i = 0; i < c->count; i++) {
+        Item *item = &c->items[i];
+        if (item->status == ITEM_MALFORMED)
+            continue;
+
+        if (!c->solved[i]) {
+            item->status = ITEM_UNSOLVABLE;
+        } else if (pl->audit && !c->unique[i]) {
+            item->status = ITEM_NON_UNIQUE;
+        } else if (item->expected[0]) {
+            char got[BOARD_LINE_LEN + 1];
+            board_to_line(c->boards[i], got);
+            item->status = memcmp(got, item->expected, BOARD_LINE_LEN) == 0
+                           ? ITEM_OK : ITEM_MISMATCH;
+        }
+    }
+
+    pthread_mutex_lock(&pl->lock);
+    pl->slots[c->seq % pl->window] = c;
+    pthread_cond_broadcast(&pl->cv);
+    pthread_mutex_unlock(&pl->lock);
+}
+
+static bool item_flagged(const Item *item)
+{
+    return item->status != ITEM_OK && item->status != ITEM_SOLVED;
+}
+
+// Keeps the TOP_PUZZLES items with the most search nodes
+static void track_heaviest(Pipeline *pl, const Item *item)
+{
+    int i = pl->ntop < TOP_PUZZLES ? pl->ntop++ : TOP_PUZZLES - 1;
+    if (i == TOP_PUZZLES - 1 && pl->ntop == TOP_PUZZLES &&
+        pl->top[i].stats.nodes >= item->stats.nodes)
+        return;
+
+    for (; i > 0 && pl->top[i - 1].stats.nodes < item->stats.nodes; i--)
+        pl->top[i] = pl->top[i - 1];
+    pl->top[i] = *item;
+}
+
+static void write_chunk(Pipeline *pl, Chunk *c)
+{
+    // "puzzle,solution,status[,stats]\n" per row (audit:
+    // "line,puzzle,status\n" per flagged row), written with one fwrite
+    char buf[CHUNK_PUZZLES * (2 * BOARD_LINE_LEN + 128)];
+    size_t pos = 0;
+
+    for (int i = 0; i < c->count; i++) {
+        Item *item = &c->items[i];
+        pl->counts[item->status]++;
+        if (pl->stats && item->status != ITEM_MALFORMED)
+            track_heaviest(pl, item);
+
+        if (item->status == ITEM_MALFORMED)
+            fprintf(stderr, "line %ld: malformed row\n", item->line_no);
+
+        if (pl->quiet)
+            continue;
+
+        if (pl->audit) {
+            if (item_flagged(item))
+                pos += (size_t)snprintf(buf + pos, sizeof(buf) - pos, "%ld,%s,%s\n",
+                                        item->line_no, item->puzzle,
+                                        item_status_names[item->status]);
+            continue;
+        }
+
+        char sol[BOARD_LINE_LEN + 1] = "";
+        if (item->status != ITEM_UNSOLVABLE && item->status != ITEM_MALFORMED)
+            board_to_line(c->boards[i], sol);
+
+        pos += (size_t)snprintf(buf + pos, sizeof(buf) - pos, "%s,%s,%s",
+                                item->puzzle, sol, item_status_names[item->status]);
+        if (pl->stats)
+            pos += (size_t)snprintf(buf + pos, sizeof(buf) - pos, ",%llu,%llu,%u,%llu,%.1f",
+                                    (unsigned long long)item->stats.nodes,
+                                    (unsigned long long)item->stats.backtracks,
+                                    item->stats.max_depth,
+                                    (unsigned long long)item->stats.propagations,
+                                    item->stats.elapsed_ns / 1e3);
+        buf[pos++] = '\n';
+    }
+
+    if (pos > 0)
+        fwrite(buf, 1, pos, pl->out);
+}
+
+static void *writer_main(void *arg)
+{
+    Pipeline *pl = arg;
+
+    for (;;) {
+        pthread_mutex_lock(&pl->lock);
+        Chunk *c;
+        while (!(c = pl->slots[pl->next_write % pl->window]) &&
+               !(pl->eof && pl->next_write == pl->next_read))
+            pthread_cond_wait(&pl->cv, &pl->lock);
+        if (c)
+            pl->slots[pl->next_write % pl->window] = NULL;
+        pthread_mutex_unlock(&pl->lock);
+
+        if (!c)
+            break; // input exhausted and everything written
+
+        write_chunk(pl, c);
+        free(c);
+
+        pthread_mutex_lock(&pl->lock);
+        pl->next_write++;
+        pthread_cond_broadcast(&pl->cv);
+        pthread_mutex_unlock(&pl->lock);
+    }
+
+    fflush(pl->out);
+    return NULL;
+}
+
+static int run_pipeline(bool audit, int argc, char *argv[])
+{
+    const char *in_path = "-";
+    const char *out_path = NULL;
+    const char *trace_path = NULL;
+    bool have_input = false;
+    int threads = 0;
+    int rc = 1;
+
+    Pipeline pl = {0};
+    WorkPool *pool = NULL;
+    pl.audit = audit;
+    pl.use_batch = !audit;
+    pl.engine = solver_get_engine();
+    pthread_mutex_init(&pl.lock, NULL);
+    pthread_cond_init(&pl.cv, NULL);
+
+    for (int i = 0; i < argc; i++) {
+        const char *a = argv[i];
+        if (strcmp(a, "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (!audit && strcmp(a, "--engine") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            if (strcmp(name, "batch") == 0) {
+                pl.use_batch = true;
+            } else if (solver_engine_from_name(name, &pl.engine)) {
+                pl.use_batch = false;
+            } else {
+                fprintf(stderr, "Error: unknown engine '%s'.\n", name);
+                goto done;
+            }
+        } else if ((strcmp(a, "--output") == 0 || strcmp(a, "-o") == 0) && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (strcmp(a, "--quiet") == 0 || strcmp(a, "-q") == 0) {
+            pl.quiet = true;
+        } else if (!audit && strcmp(a, "--stats") == 0) {
+            pl.stats = true;
+        } else if (!audit && strcmp(a, "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (!have_input && (a[0] != '-' || strcmp(a, "-") == 0)) {
+            in_path = a;
+            have_input = true;
+        } else {
+            solve_usage(audit);
+            goto done;
+        }
+    }
+
+    if (pl.stats || trace_path) {
+        // Counters are per puzzle, which the batch kernel does not have
+        if (pl.use_batch) {
+            pl.use_batch = false;
+            pl.engine = SOLVER_MRV;
+        }
+#ifndef SUDOKU_SOLVER_STATS
+        fprintf(stderr, "Note: built without SUDOKU_SOLVER_STATS, only solve times are recorded.\n");
+#endif
+    }
+    if (trace_path) {
+        pl.trace = fopen(trace_path, "w");
+        if (!pl.trace) {
+            fprintf(stderr, "Could not create %s\n", trace_path);
+            goto done;
+        }
+        threads = 1; // one trace stream, one puzzle at a time
+    }
+
+    pl.in = strcmp(in_path, "-") == 0 ? stdin : fopen(in_path, "r");
+    if (!pl.in) {
+        fprintf(stderr, "Could not open %s\n", in_path);
+        goto done;
+    }
+    pl.out = out_path ? fopen(out_path, "w") : stdout;
+    if (!pl.out) {
+        fprintf(stderr, "Could not create %s\n", out_path);
+        goto done;
+    }
+
+    pool = pool_create(threads);
+    if (!pool) {
+        fprintf(stderr, "Could not start solver threads\n");
+        goto done;
+    }
+
+    pl.window = 4 * pool_threads(pool);
+    pl.slots = calloc((size_t)pl.window, sizeof(Chunk *));
+
+    uint64_t start = time_now_ns();
+
+    pthread_t writer;
+    if (!pl.slots || pthread_create(&writer, NULL, writer_main, &pl) != 0) {
+        fprintf(stderr, "Could not start writer thread\n");
+        goto done;
+    }
+
+    for (;;) {
+        pthread_mutex_lock(&pl.lock);
+        while (pl.next_read - pl.next_write >= pl.window)
+            pthread_cond_wait(&pl.cv, &pl.lock);
+        pthread_mutex_unlock(&pl.lock);
+
+        Chunk *c = malloc(sizeof(Chunk));
+        if (!c) {
+            perror("malloc");
+            break;
+        }
+        c->pl = &pl;
+        c->seq = pl.next_read;
+
+        if (read_chunk(&pl, c) == 0) {
+            free(c);
+            break;
+        }
+
+        pthread_mutex_lock(&pl.lock);
+        pl.next_read++;
+        pthread_mutex_unlock(&pl.lock);
+
+        pool_submit(pool, solve_chunk, c);
+    }
+
+    pthread_mutex_lock(&pl.lock);
+    pl.eof = true;
+    pthread_cond_broadcast(&pl.cv);
+    pthread_mutex_unlock(&pl.lock);
+
+    pthread_join(writer, NULL);
+    threads = pool_threads(pool);
+    pool_destroy(pool);
+    pool = NULL;
+
+    double secs = (double)(time_now_ns() - start) / 1e9;
+    long total = 0;
+    for (int s = 0; s <= ITEM_MALFORMED; s++)
+        total += pl.counts[s];
+
+    fprintf(stderr,
+            "%s %ld puzzles in %.3f s (%.0f puzzles/sec, %d threads, engine %s)\n"
+            "  ok: %ld  solved: %ld  mismatch: %ld  unsolvable: %ld  non-unique: %ld  malformed: %ld\n",
+            audit ? "Audited" : "Processed",
+            total, secs, secs > 0 ? (double)total / secs : 0.0, threads,
+            audit ? "count" : pl.use_batch ? "batch" : solver_engine_name(pl.engine),
+            pl.counts[ITEM_OK], pl.counts[ITEM_SOLVED], pl.counts[ITEM_MISMATCH],
+            pl.counts[ITEM_UNSOLVABLE], pl.counts[ITEM_NON_UNIQUE], pl.counts[ITEM_MALFORMED]);
+
+    if (pl.stats && pl.ntop > 0) {
+        fprintf(stderr, "  heaviest puzzles (by search nodes):\n");
+        for (int i = 0; i < pl.ntop; i++) {
+            const Item *it = &pl.top[i];
+            fprintf(stderr, "    line %ld: %llu nodes, %llu backtracks, depth %u, %.1f us\n",
+                    it->line_no, (unsigned long long)it->stats.nodes,
+                    (unsigned long long)it->stats.backtracks, it->stats.max_depth,
+                    it->stats.elapsed_ns / 1e3);
+        }
+    }
+
+    rc = (pl.counts[ITEM_MISMATCH] || pl.counts[ITEM_UNSOLVABLE] ||
+          pl.counts[ITEM_NON_UNIQUE] || pl.counts[ITEM_MALFORMED]) ? 1 : 0;
+
+done:
+    pool_destroy(pool);
+    if (pl.in && pl.in != stdin)
+        fclose(pl.in);
+    if (pl.out && pl.out != stdout)
+        fclose(pl.out);
+    if (pl.trace)
+        fclose(pl.trace);
+    free(pl.slots);
+    pthread_mutex_destroy(&pl.lock);
+    pthread_cond_destroy(&pl.cv);
+    return rc;
+}
+
+int run_solve(int argc, char *argv[])
+{
+    return run_pipeline(false, argc, argv);
+}
+
+int run_audit(int argc, char *argv[])
+{
+    return run_pipeline(true, argc, argv);
+}
+
+typedef struct {
+    Difficulty difficulty;
+    int clues;
+    FILE *out;
+    pthread_mutex_t lock;   // serialises whole-task writes to out
+} GenJob;
+
+typedef struct {
+    GenJob *job;
+    uint64_t seed;
+    int count;
+} GenTask;
+
+static void generate_task(void *arg)
+{
+    GenTask *t = arg;
+    GenRng rng;
+    gen_rng_seed(&rng, t->seed);
+
+    char buf[GEN_TASK_PUZZLES * (2 * BOARD_LINE_LEN + 2)];
+    size_t pos = 0;
+
+    for (int i = 0; i < t->count; i++) {
+        Board puzzle, solution;
+        generate_random_puzzle(puzzle, solution, t->job->difficulty, t->job->clues, &rng);
+
+        board_to_line(puzzle, buf + pos);
+        pos += BOARD_LINE_LEN;
+        buf[pos++] = ',';
+        board_to_line(solution, buf + pos);
+        pos += BOARD_LINE_LEN;
+        buf[pos++] = '\n';
+    }
+
+    pthread_mutex_lock(&t->job->lock);
+    fwrite(buf, 1, pos, t->job->out);
+    pthread_mutex_unlock(&t->job->lock);
+}
+
+int run_generate(int argc, char *argv[])
+{
+    long count = 1;
+    int threads = 0;
+    const char *out_path = NULL;
+    uint64_t seed = (uint64_t)time(NULL);
+
+    GenJob job = {0};
+    job.difficulty = DIFFICULTY_ANY;
+
+    for (int i = 0; i < argc; i++) {
+        const char *a = argv[i];
+        if (strcmp(a, "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(a, "--difficulty") == 0 && i + 1 < argc) {
+            if (!difficulty_from_name(argv[++i], &job.difficulty)) {
+                fprintf(stderr, "Error: unknown difficulty '%s'.\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(a, "--clues") == 0 && i + 1 < argc) {
+            job.clues = atoi(argv[++i]);
+            if (job.clues < 17 || job.clues > BOARD_LINE_LEN) {
+                fprintf(stderr, "Error: clue count must be between 17 and 81.\n");
+                return 1;
+            }
+        } else if (strcmp(a, "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if ((strcmp(a, "--output") == 0 || strcmp(a, "-o") == 0) && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (a[0] != '-' && atol(a) > 0) {
+            count = atol(a);
+        } else {
+            fprintf(stderr,
+                    "Usage: sudoku generate [COUNT] [--difficulty easy|medium|hard]\n"
+                    "                       [--clues N] [--threads N] [--seed S] [--output FILE]\n");
+            return 1;
+        }
+    }
+
+    job.out = out_path ? fopen(out_path, "w") : stdout;
+    if (!job.out) {
+        fprintf(stderr, "Could not create %s\n", out_path);
+        return 1;
+    }
+    pthread_mutex_init(&job.lock, NULL);
+
+    long ntasks = (count + GEN_TASK_PUZZLES - 1) / GEN_TASK_PUZZLES;
+    GenTask *tasks = calloc((size_t)ntasks, sizeof(GenTask));
+    WorkPool *pool = tasks ? pool_create(threads) : NULL;
+    if (!pool) {
+        fprintf(stderr, "Could not start generator threads\n");
+        free(tasks);
+        return 1;
+    }
+
+    fprintf(job.out, "quizzes,solutions\n");
+    uint64_t start = time_now_ns();
+
+    for (long i = 0; i < ntasks; i++) {
+        tasks[i].job = &job;
+        tasks[i].seed = seed + (uint64_t)i;
+        tasks[i].count = (int)(i == ntasks - 1 ? count - i * GEN_TASK_PUZZLES : GEN_TASK_PUZZLES);
+        pool_submit(pool, generate_task, &tasks[i]);
+    }
+
+    pool_wait(pool);
+    threads = pool_threads(pool);
+    pool_destroy(pool);
+
+    double secs = (double)(time_now_ns() - start) / 1e9;
+    fprintf(stderr, "Generated %ld %s puzzles in %.3f s (%.0f puzzles/sec, %d threads)\n",
+            count, difficulty_name(job.difficulty), secs,
+            secs > 0 ? (double)count / secs : 0.0, threads);
+
+    if (job.out != stdout)
+        fclose(job.out);
+    pthread_mutex_destroy(&job.lock);
+    free(tasks);
+    return 0;
+}
@@ -0,0 +1,18 @@
+#ifndef RUNNER_H
+#define RUNNER_H
+
+// Offline modes that push puzzle files through the solver.
+// argv holds the arguments after the mode name.
+
+int run_solve(int argc, char *argv[]);
+
+// Checks every row has exactly one solution (and that it matches the
+// solutions column); prints only the rows that fail. A row whose puzzle
+// or solutions column cannot be read counts as malformed, and any failure
+// makes the exit status non-zero.
+int run_audit(int argc, char *argv[]);
+
+// Writes freshly generated unique puzzles in the sudoku.csv format
+int run_generate(int argc, char *argv[]);
+
+#endif //RUNNER_H
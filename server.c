@@ -0,0 +1,1703 @@
+#include "server.h"
+#include "net.h"
+#include "evloop.h"
+#include "linebuf.h"
+#include "outbuf.h"
+#include "proto.h"
+#include "game.h"
+#include "generator.h"
+#include "prefetch.h"
+#include "solver.h"
+#include "timeutil.h"
+#include "timerwheel.h"
+#include "metrics.h"
+#include "pool.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+
+#ifdef _WIN32
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+    #define close closesocket
+    #define SHUT_RDWR SD_BOTH
+#else
+    #include <unistd.h>
+    #include <signal.h>
+    #include <sys/socket.h>
+#endif
+
+// One event loop per reactor thread over non-blocking sockets. Each game
+// is a Room that lives on one reactor and is driven by its input and
+// timers, so moves take no locks; only the lobby is shared.
+
+#define MAX_EVENTS         256
+#define LINE_MAX_LEN       128  // longest accepted input line
+#define TICK_MS            100  // longest wait in the event loop
+#define TIMER_TICK_MS      10   // timing wheel resolution
+#define MAX_TURN_SECONDS   600  // also keeps RULES within its 16 bits
+#define HANDSHAKE_GRACE_MS 300
+#define CLOSE_GRACE_MS     5000 // for a finished connection's last output
+#define PREFETCH_PUZZLES   64   // for DIFFICULTY_ANY, the usual request
+#define PREFETCH_LEVEL     16   // for each named difficulty
+#define LOBBY_QUEUES       (DIFFICULTY_HARD + 1)
+#define FRAME_MIN_CAP      2048
+#define PLAYER_QUEUE_LIMIT    (64 * 1024)   // unsent bytes before a player is dropped
+#define SPECTATOR_QUEUE_LIMIT (8 * 1024)    // before a spectator skips ahead
+#define SOCKET_SEND_BUFFER (32 * 1024)    // kernel side of each send queue
+#define QUEUE_REPORT_MS    60000
+
+typedef enum {
+    ROOM_WAITING,   // one player connected
+    ROOM_TURN,      // waiting for the current player's move
+    ROOM_MENU       // waiting for player 1's R/N/Q
+} RoomPhase;
+
+typedef enum {
+    CONN_HANDSHAKE, // waiting for HELLO or the grace timeout
+    CONN_READY      // mode chosen, in the lobby or a room
+} ConnState;
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} Frame;
+
+typedef struct Conn Conn;
+typedef struct Room Room;
+typedef struct Reactor Reactor;
+typedef struct Server Server;
+
+struct Conn {
+    Reactor *reactor;
+    int fd;                 // -1 once closed
+    ConnState state;
+    ProtoMode mode;
+    Difficulty difficulty;  // asked for in HELLO, DIFFICULTY_ANY if not
+    Room *room;
+    int slot;               // 0 = player 1, 1 = player 2; for a spectator
+                            // its index in room->spectators
+    bool spectating;        // asked for role=spectate: watches, never plays
+    int watch_id;           // room to watch, 0 = the newest game
+    int turn_seconds;       // asked for in HELLO, 0 = server default
+
+    LineBuf in;
+
+    OutQueue out;           // blocks the socket did not take yet
+    bool writing;           // EV_WRITE registered
+    bool closing;           // close once out is drained
+    bool aborted;           // output stopped, waiting for the hangup
+
+    Timer timer;            // handshake grace, then idle reaping once seated
+
+    Conn *next_dead;
+};
+
+struct Room {
+    Reactor *reactor;
+    int id;
+    Conn *players[2];
+    Difficulty difficulty;  // lobby queue while waiting, then the puzzles'
+    GameState game;
+    int scores[2];
+    int turn;
+    RoomPhase phase;
+    int turn_seconds;
+    Timer timer;            // end of the current turn or menu
+    uint64_t turn_ended_ns; // last move or timeout, until the next turn goes out
+
+    unsigned modes;                 // bit per ProtoMode its players speak
+    Conn **spectators;
+    size_t nspectators;
+    size_t spectators_cap;
+    int audience[PROTO_MODES];      // spectators per ProtoMode
+    Frame frames[PROTO_MODES];      // pending output, one per protocol
+    ProtoMsgType prompt[2];         // per-player prompt sent after the frame,
+                                    // MSG_YOUR_MOVE / MSG_YOUR_MENU or 0
+
+    Room *prev, *next;
+};
+
+// A connection passed to another reactor
+typedef struct {
+    Conn *conn;
+    Room *room;             // waiting room to join there; NULL = unassigned
+} Handoff;
+
+typedef struct {
+    pthread_mutex_t lock;
+    Handoff *items;
+    size_t len;
+    size_t cap;
+    int wake[2];            // pipe registered in the loop; -1 on Windows,
+                            // where the mailbox is drained every tick
+} Mailbox;
+
+struct Reactor {
+    Server *server;
+    const ServerOptions *opt;
+    EvLoop *loop;
+    int listen_fd;          // -1 if this reactor does not accept
+    Mailbox mailbox;
+    int index;              // position in server->reactors
+    Room *rooms;            // every room owned by this reactor
+    TimerWheel timers;
+    Conn *dead;             // closed this iteration, freed at its end
+    unsigned next_target;   // round-robin position when dealing sockets
+    GenRng rng;             // puzzles made here when a prefetch ring is empty
+    MetricsShard *metrics;  // written only by this reactor's thread
+    pthread_t thread;
+};
+
+struct Server {
+    const ServerOptions *opt;
+    Reactor *reactors;
+    int nreactors;
+    bool shared_listen;     // every reactor has its own listener
+
+    pthread_mutex_t lobby_lock;
+    Room *lobby[LOBBY_QUEUES];  // room with one player per difficulty,
+                                // owned by its reactor
+    atomic_int next_room_id;
+    atomic_int last_started;    // newest game, watched by default
+    unsigned long long reported;    // queue events in the last report
+};
+
+static Prefetcher *g_prefetch[LOBBY_QUEUES];
+static Difficulty g_levels[LOBBY_QUEUES] = {
+    DIFFICULTY_ANY, DIFFICULTY_EASY, DIFFICULTY_MEDIUM, DIFFICULTY_HARD
+};
+
+void server_default_options(ServerOptions *opt)
+{
+    opt->port = 5555;
+    opt->turn_seconds = 20;
+    opt->menu_seconds = 60;
+    opt->idle_seconds = 300;
+    opt->threads = 0;
+    opt->admin_port = 0;
+}
+
+bool server_parse_options(ServerOptions *opt, int argc, char *argv[])
+{
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "--turn-seconds") == 0 && i + 1 < argc) {
+            opt->turn_seconds = atoi(argv[++i]);
+            if (opt->turn_seconds <= 0 || opt->turn_seconds > MAX_TURN_SECONDS)
+                return false;
+        } else if (strcmp(argv[i], "--menu-seconds") == 0 && i + 1 < argc) {
+            opt->menu_seconds = atoi(argv[++i]);
+            if (opt->menu_seconds <= 0)
+                return false;
+        } else if (strcmp(argv[i], "--idle-seconds") == 0 && i + 1 < argc) {
+            opt->idle_seconds = atoi(argv[++i]);
+            if (opt->idle_seconds <= 0)
+                return false;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            opt->threads = atoi(argv[++i]);
+            if (opt->threads < 0)
+                return false;
+        } else if (strcmp(argv[i], "--admin-port") == 0 && i + 1 < argc) {
+            opt->admin_port = atoi(argv[++i]);
+            if (opt->admin_port <= 0)
+                return false;
+        } else if (argv[i][0] != '-' && atoi(argv[i]) > 0) {
+            opt->port = atoi(argv[i]);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Next puzzle for a game: normally a dequeue from the difficulty's
+// prefetch ring. If the producer has fallen behind, make one here with
+// the reactor's generator and return false. This runs on the reactor, so
+// a hard puzzle gets a single removal pass (as few clues as uniqueness
+// allows) rather than the repeated passes that look for one singles
+// cannot crack.
+static bool load_next_puzzle(Reactor *r, Difficulty d, Board puzzle, Board solution)
+{
+    if (g_prefetch[d] && prefetch_take(g_prefetch[d], puzzle, solution))
+        return true;
+
+    for (int attempt = 0; d == DIFFICULTY_ANY && attempt < 8; attempt++) {
+        generate_puzzle(puzzle, solution);
+        if (solver_verify_pair(puzzle, solution))
+            return false;
+    }
+
+    if (d == DIFFICULTY_HARD)
+        generate_random_puzzle(puzzle, solution, DIFFICULTY_ANY, 1, &r->rng);
+    else
+        generate_random_puzzle(puzzle, solution, d, 0, &r->rng);
+    return false;
+}
+
+// ---- output frames ----
+
+static bool frame_reserve(Frame *f, size_t extra)
+{
+    if (f->len + extra <= f->cap)
+        return true;
+
+    size_t cap = f->cap ? f->cap : FRAME_MIN_CAP;
+    while (cap < f->len + extra)
+        cap *= 2;
+    char *grown = realloc(f->data, cap);
+    if (!grown)
+        return false;
+    f->data = grown;
+    f->cap = cap;
+    return true;
+}
+
+static void frame_vprintf(Frame *f, const char *fmt, va_list ap)
+{
+    for (;;) {
+        size_t left = f->cap - f->len;
+        va_list copy;
+        va_copy(copy, ap);
+        int n = vsnprintf(f->data ? f->data + f->len : NULL, left, fmt, copy);
+        va_end(copy);
+
+        if (n < 0)
+            return;
+        if ((size_t)n < left) {
+            f->len += (size_t)n;
+            return;
+        }
+        if (!frame_reserve(f, (size_t)n + 1))
+            return;
+    }
+}
+
+static void frame_printf(Frame *f, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    frame_vprintf(f, fmt, ap);
+    va_end(ap);
+}
+
+// Appends one binary frame
+static void frame_encode(Frame *f, ProtoMsgType type, const uint8_t *payload, size_t len)
+{
+    if (frame_reserve(f, PROTO_HEADER + len))
+        f->len += proto_encode((uint8_t *)f->data + f->len, type, payload, len);
+}
+
+static void frame_render_game(Frame *f, const GameState *g)
+{
+    if (frame_reserve(f, GAME_RENDER_MAX))
+        f->len += game_render(g, f->data + f->len, f->cap - f->len);
+}
+
+// ---- connections ----
+
+static uint64_t seconds_from_now(int seconds)
+{
+    return time_now_ns() + (uint64_t)seconds * 1000000000u;
+}
+
+static void conn_close(Conn *c)
+{
+    if (c->fd < 0)
+        return;
+
+    timerwheel_cancel(&c->reactor->timers, &c->timer);
+    evloop_del(c->reactor->loop, c->fd);
+    close(c->fd);
+    c->fd = -1;
+
+    c->next_dead = c->reactor->dead;
+    c->reactor->dead = c;
+}
+
+static void conn_update_events(Conn *c)
+{
+    bool want = c->out.bytes > 0;
+    if (want != c->writing) {
+        c->writing = want;
+        evloop_mod(c->reactor->loop, c->fd, EV_READ | (want ? EV_WRITE : 0), c);
+    }
+}
+
+// Drops c's output and shuts the socket down without closing it. The loop
+// then sees it readable at EOF and conn_on_disconnect() takes it out of
+// its room, so a send failing in the middle of a room event never frees a
+// connection the room is still iterating over. A closing connection has
+// already left its room and is closed at once.
+static void conn_abort(Conn *c)
+{
+    if (c->fd < 0 || c->aborted)
+        return;
+    if (c->closing) {
+        conn_close(c);
+        return;
+    }
+    c->aborted = true;
+    outq_clear(&c->out);
+    shutdown(c->fd, SHUT_RDWR);
+    conn_update_events(c);
+}
+
+// Queues a reference to b behind anything still unsent
+static void conn_queue(Conn *c, OutBuf *b)
+{
+    if (c->fd < 0 || c->aborted || !b)
+        return;
+    if (!outq_push(&c->out, b, 0))
+        conn_abort(c);
+}
+
+// Sends what the socket takes now and keeps the rest for EV_WRITE
+static void conn_send(Conn *c)
+{
+    if (c->fd < 0 || c->aborted)
+        return;
+
+    while (c->out.bytes > 0) {
+        long n = outq_send(&c->out, c->fd);
+        if (n > 0)
+            metrics_count(c->reactor->metrics, METRIC_BYTES_OUT, (uint64_t)n);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                conn_abort(c);
+                return;
+            }
+            break;
+        }
+    }
+
+    if (c->out.bytes > 0) {
+        metrics_count(c->reactor->metrics, METRIC_SEND_BACKLOGS, 1);
+        metrics_peak(c->reactor->metrics, GAUGE_QUEUE_PEAK, (int64_t)c->out.bytes);
+    }
+    conn_update_events(c);
+}
+
+// Output only c gets, such as its WELCOME line
+static void conn_write(Conn *c, const char *data, size_t len)
+{
+    if (c->fd < 0 || c->aborted || len == 0)
+        return;
+
+    OutBuf *b = outbuf_new(data, len);
+    if (!b) {
+        conn_abort(c);
+        return;
+    }
+    conn_queue(c, b);
+    outbuf_unref(b);
+    conn_send(c);
+}
+
+static void conn_puts(Conn *c, const char *s)
+{
+    conn_write(c, s, strlen(s));
+}
+
+// Closes as soon as everything queued has been sent, or after
+// CLOSE_GRACE_MS if the peer is not reading it
+static void conn_finish(Conn *c)
+{
+    if (c->fd < 0)
+        return;
+    c->closing = true;
+    if (c->out.bytes == 0) {
+        conn_close(c);
+        return;
+    }
+    timerwheel_add(&c->reactor->timers, &c->timer,
+                   time_now_ns() + (uint64_t)CLOSE_GRACE_MS * 1000000u);
+}
+
+static void conn_on_writable(Conn *c)
+{
+    conn_send(c);
+
+    if (c->closing && c->out.bytes == 0)
+        conn_close(c);
+}
+
+static void conn_on_timer(Timer *t);
+
+// New connection, not yet registered with any loop
+static Conn *conn_create(int fd)
+{
+    Conn *c = calloc(1, sizeof(*c));
+    if (!c || !linebuf_init(&c->in, LINE_MAX_LEN) || net_set_nonblocking(fd) < 0) {
+        if (c)
+            linebuf_free(&c->in);
+        free(c);
+        close(fd);
+        return NULL;
+    }
+    // Best effort: with the default the kernel would buffer megabytes for
+    // a stalled peer before the queue limits ever see it
+    net_set_send_buffer(fd, SOCKET_SEND_BUFFER);
+    c->fd = fd;
+    c->state = CONN_HANDSHAKE;
+    timer_init(&c->timer, conn_on_timer, c);
+    return c;
+}
+
+// Registers c with r's loop; on failure c is closed
+static bool conn_attach(Reactor *r, Conn *c)
+{
+    c->reactor = r;
+    c->writing = c->out.bytes > 0;
+    if (evloop_add(r->loop, c->fd, EV_READ | (c->writing ? EV_WRITE : 0), c) < 0) {
+        close(c->fd);
+        c->fd = -1;
+        c->next_dead = r->dead;
+        r->dead = c;
+        return false;
+    }
+    return true;
+}
+
+// Takes c out of its loop so another reactor can attach it
+static void conn_detach(Conn *c)
+{
+    timerwheel_cancel(&c->reactor->timers, &c->timer);
+    evloop_del(c->reactor->loop, c->fd);
+}
+
+// A player who is still there may say nothing through the other player's
+// turn, the menu and then their own turn, so the limit is never below that
+static int conn_idle_seconds(const Conn *c)
+{
+    int idle = c->reactor->opt->idle_seconds;
+    int quiet = 2 * c->room->turn_seconds + c->reactor->opt->menu_seconds;
+    return idle > quiet ? idle : quiet;
+}
+
+// Input from a seated player: the idle clock starts again
+static void conn_touch(Conn *c)
+{
+    if (c->room && !c->spectating)
+        timerwheel_add(&c->reactor->timers, &c->timer, seconds_from_now(conn_idle_seconds(c)));
+}
+
+// ---- rooms ----
+
+static bool room_speaks(const Room *room, ProtoMode mode)
+{
+    return (room->modes & (1u << mode)) != 0 || room->audience[mode] > 0;
+}
+
+// Appends to the frame sent to players of one protocol at room_flush()
+static void room_say(Room *room, ProtoMode mode, const char *fmt, ...)
+{
+    if (!room_speaks(room, mode))
+        return;
+
+    va_list ap;
+    va_start(ap, fmt);
+    frame_vprintf(&room->frames[mode], fmt, ap);
+    va_end(ap);
+}
+
+static void room_send_board(Room *room)
+{
+    if (room_speaks(room, PROTO_TEXT))
+        frame_render_game(&room->frames[PROTO_TEXT], &room->game);
+}
+
+// Appends one binary frame; the payload bytes follow the message
+static void room_emit(Room *room, ProtoMsgType type, size_t len, ...)
+{
+    uint8_t payload[PROTO_MAX_PAYLOAD];
+    va_list ap;
+
+    if (!room_speaks(room, PROTO_BINARY))
+        return;
+
+    va_start(ap, len);
+    for (size_t i = 0; i < len; i++)
+        payload[i] = (uint8_t)va_arg(ap, int);
+    va_end(ap);
+
+    frame_encode(&room->frames[PROTO_BINARY], type, payload, len);
+}
+
+static void room_note(Room *room, ProtoNote note)
+{
+    room_say(room, PROTO_TEXT, proto_note_text(note), room->turn + 1);
+    room_say(room, PROTO_DELTA, "NOTE %s\n", proto_note_name(note));
+    room_emit(room, MSG_NOTE, 1, note);
+}
+
+// Prompt only this player gets, after the frame
+static void room_prompt(Room *room, int slot, ProtoMsgType prompt)
+{
+    room->prompt[slot] = prompt;
+}
+
+// YOUR_MOVE / YOUR_MENU as lines and as frames, made once and shared by
+// every reactor
+static OutBuf *g_prompts[2][2];    // [binary][menu]
+
+static bool prompts_init(void)
+{
+    static const uint8_t bin_move[PROTO_HEADER] = { MSG_YOUR_MOVE, 0, 0 };
+    static const uint8_t bin_menu[PROTO_HEADER] = { MSG_YOUR_MENU, 0, 0 };
+
+    g_prompts[0][0] = outbuf_new("YOUR_MOVE\n", 10);
+    g_prompts[0][1] = outbuf_new("YOUR_MENU\n", 10);
+    g_prompts[1][0] = outbuf_new(bin_move, sizeof(bin_move));
+    g_prompts[1][1] = outbuf_new(bin_menu, sizeof(bin_menu));
+    return g_prompts[0][0] && g_prompts[0][1] && g_prompts[1][0] && g_prompts[1][1];
+}
+
+static OutBuf *prompt_buf(ProtoMode mode, ProtoMsgType prompt)
+{
+    if (prompt != MSG_YOUR_MOVE && prompt != MSG_YOUR_MENU)
+        return NULL;
+    return g_prompts[mode == PROTO_BINARY][prompt == MSG_YOUR_MENU];
+}
+
+static void room_snapshot(const Room *room, ProtoMode mode, Frame *f);
+
+// A spectator that has fallen this far behind skips everything it has not
+// started to receive and gets the room's current state instead, so a
+// stalled watcher holds one snapshot at most and never holds up the game
+static void room_resync(Room *room, Conn *c)
+{
+    MetricsShard *m = room->reactor->metrics;
+    Frame f = { 0 };
+
+    metrics_count(m, METRIC_SKIPPED_BYTES, outq_trim(&c->out));
+    metrics_count(m, METRIC_RESYNCS, 1);
+
+    room_snapshot(room, c->mode, &f);
+    conn_write(c, f.data, f.len);
+    free(f.data);
+}
+
+// Gives c the shared block for its protocol. Queues are bounded: a slow
+// spectator skips ahead to the latest state, while a player, whose client
+// needs every message, is disconnected. A frame that could not be copied
+// into a block would leave c out of step, so c is dropped then too.
+static void room_deliver(Room *room, Conn *c, OutBuf *const bufs[PROTO_MODES], OutBuf *prompt)
+{
+    size_t len = room->frames[c->mode].len;
+
+    if (len > 0 && !bufs[c->mode]) {
+        conn_abort(c);
+        return;
+    }
+    if (c->spectating && c->out.bytes > SPECTATOR_QUEUE_LIMIT) {
+        room_resync(room, c);
+        return;
+    }
+    if (!c->spectating && c->out.bytes + len > PLAYER_QUEUE_LIMIT) {
+        printf("SERVER: room %d: player %d is not reading, disconnecting (%zu bytes queued)\n",
+               room->id, c->slot + 1, c->out.bytes);
+        fflush(stdout);
+        metrics_count(room->reactor->metrics, METRIC_SLOW_PLAYERS, 1);
+        conn_abort(c);
+        return;
+    }
+    conn_queue(c, bufs[c->mode]);
+    conn_queue(c, prompt);
+    conn_send(c);
+}
+
+// Sends the pending frames. Each protocol's frame is copied once into an
+// immutable block and every player and spectator speaking it queues a
+// reference, players with their own prompt behind it, so the cost per
+// recipient is one gathered send rather than a copy of the frame.
+static void room_flush(Room *room)
+{
+    OutBuf *bufs[PROTO_MODES] = { NULL };
+
+    for (int m = 0; m < PROTO_MODES; m++) {
+        if (room->frames[m].len > 0)
+            bufs[m] = outbuf_new(room->frames[m].data, room->frames[m].len);
+    }
+
+    for (int i = 0; i < 2; i++) {
+        if (room->players[i])
+            room_deliver(room, room->players[i], bufs,
+                         prompt_buf(room->players[i]->mode, room->prompt[i]));
+    }
+    // The players have the new turn; spectators do not hold up its clock
+    if (room->turn_ended_ns && room->phase == ROOM_TURN)
+        metrics_latency(room->reactor->metrics, LATENCY_TURN_TTFB,
+                        time_now_ns() - room->turn_ended_ns);
+    room->turn_ended_ns = 0;
+    for (size_t i = 0; i < room->nspectators; i++)
+        room_deliver(room, room->spectators[i], bufs, NULL);
+
+    for (int m = 0; m < PROTO_MODES; m++) {
+        outbuf_unref(bufs[m]);
+        room->frames[m].len = 0;
+    }
+    room->prompt[0] = room->prompt[1] = 0;
+}
+
+static void room_on_timer(Timer *t);
+
+static Room *room_create(Reactor *r, Difficulty d)
+{
+    Room *room = calloc(1, sizeof(*room));
+    if (!room)
+        return NULL;
+
+    room->reactor = r;
+    room->difficulty = d;
+    // Ids grow with creation order and id % nreactors is the owner, which
+    // is all a spectator needs to find the room
+    room->id = (atomic_fetch_add(&r->server->next_room_id, 1) + 1) * r->server->nreactors + r->index;
+    room->phase = ROOM_WAITING;
+    timer_init(&room->timer, room_on_timer, room);
+    metrics_gauge(r->metrics, GAUGE_ROOMS, 1);
+    room->next = r->rooms;
+    if (r->rooms)
+        r->rooms->prev = room;
+    r->rooms = room;
+    return room;
+}
+
+static void room_free(Room *room)
+{
+    Reactor *r = room->reactor;
+
+    if (room->prev)
+        room->prev->next = room->next;
+    else
+        r->rooms = room->next;
+    if (room->next)
+        room->next->prev = room->prev;
+    timerwheel_cancel(&r->timers, &room->timer);
+    metrics_gauge(r->metrics, GAUGE_ROOMS, -1);
+    for (int m = 0; m < PROTO_MODES; m++)
+        free(room->frames[m].data);
+    free(room->spectators);
+    free(room);
+}
+
+static void room_close(Room *room)
+{
+    room_flush(room);
+
+    for (int i = 0; i < 2; i++) {
+        Conn *c = room->players[i];
+        if (c) {
+            c->room = NULL;
+            conn_finish(c);
+        }
+    }
+    for (size_t i = 0; i < room->nspectators; i++) {
+        room->spectators[i]->room = NULL;
+        conn_finish(room->spectators[i]);
+    }
+    metrics_gauge(room->reactor->metrics, GAUGE_SPECTATORS, -(int64_t)room->nspectators);
+
+    printf("SERVER: room %d closed\n", room->id);
+    fflush(stdout);
+    room_free(room);
+}
+
+// The waiting player left. If the room is still in the lobby it can go;
+// otherwise another reactor already took it and is handing over a second
+// player, so it stays empty until that handoff arrives.
+static void room_abandon(Room *room)
+{
+    Server *s = room->reactor->server;
+    bool listed;
+
+    pthread_mutex_lock(&s->lobby_lock);
+    listed = s->lobby[room->difficulty] == room;
+    if (listed)
+        s->lobby[room->difficulty] = NULL;
+    pthread_mutex_unlock(&s->lobby_lock);
+
+    if (listed)
+        room_free(room);
+}
+
+static void room_start_turn(Room *room);
+static void room_show_menu(Room *room);
+
+static void room_start_exercise(Room *room)
+{
+    room->scores[0] = room->scores[1] = 0;
+    room->turn = 0;
+    game_reset(&room->game);
+
+    if (room_speaks(room, PROTO_DELTA) || room_speaks(room, PROTO_BINARY)) {
+        Board b;
+        game_to_board(&room->game, b);
+
+        char line[BOARD_LINE_LEN + 1];
+        board_to_line(b, line);
+        room_say(room, PROTO_DELTA, "PUZZLE %s\n", line);
+
+        uint8_t packed[PROTO_BOARD_BYTES];
+        proto_pack_board(b, packed);
+        if (room_speaks(room, PROTO_BINARY))
+            frame_encode(&room->frames[PROTO_BINARY], MSG_PUZZLE, packed, sizeof(packed));
+    }
+
+    room_start_turn(room);
+}
+
+static void room_new_puzzle(Room *room)
+{
+    MetricsShard *m = room->reactor->metrics;
+    Board puzzle, solution;
+    uint64_t start = time_now_ns();
+
+    if (!load_next_puzzle(room->reactor, room->difficulty, puzzle, solution))
+        metrics_count(m, METRIC_PREFETCH_MISSES, 1);
+    metrics_latency(m, LATENCY_PUZZLE_LOAD, time_now_ns() - start);
+    game_init(&room->game, puzzle, solution);
+    room_start_exercise(room);
+}
+
+static void room_finish_exercise(Room *room)
+{
+    room_say(room, PROTO_TEXT, PROTO_TEXT_COMPLETE);
+    room_send_board(room);
+    room_say(room, PROTO_TEXT, PROTO_TEXT_SCORES, room->scores[0], room->scores[1]);
+    room_say(room, PROTO_TEXT, "%s", proto_winner_text(room->scores[0], room->scores[1]));
+    room_say(room, PROTO_DELTA, "END\n");
+    room_emit(room, MSG_END, 0);
+
+    room_show_menu(room);
+}
+
+static void room_start_turn(Room *room)
+{
+    if (game_is_full(&room->game)) {
+        room_finish_exercise(room);
+        return;
+    }
+
+    room->phase = ROOM_TURN;
+    room_say(room, PROTO_TEXT, PROTO_TEXT_TURN,
+             room->turn + 1, room->scores[0], room->scores[1]);
+    room_send_board(room);
+    room_say(room, PROTO_DELTA, "TURN %d\n", room->turn + 1);
+    room_emit(room, MSG_TURN, 1, room->turn + 1);
+
+    room_prompt(room, room->turn, MSG_YOUR_MOVE);
+    room_flush(room);
+    timerwheel_add(&room->reactor->timers, &room->timer, seconds_from_now(room->turn_seconds));
+}
+
+static void room_next_turn(Room *room)
+{
+    room->turn = 1 - room->turn;
+    room_start_turn(room);
+}
+
+static void room_show_menu(Room *room)
+{
+    room->phase = ROOM_MENU;
+    timerwheel_add(&room->reactor->timers, &room->timer,
+                   seconds_from_now(room->reactor->opt->menu_seconds));
+
+    room_say(room, PROTO_TEXT, PROTO_TEXT_MENU);
+    room_say(room, PROTO_DELTA, "MENU\n");
+    room_emit(room, MSG_MENU, 0);
+    room_prompt(room, 0, MSG_YOUR_MENU);
+    room_flush(room);
+}
+
+// The current player's move; r < 0 if it could not be parsed
+static void room_handle_move(Room *room, int r, int c, int v)
+{
+    static const ProtoNote rejections[] = {
+        [MOVE_OUT_OF_RANGE]   = NOTE_OUT_OF_RANGE,
+        [MOVE_FIXED_CELL]     = NOTE_FIXED_CELL,
+        [MOVE_ALREADY_FILLED] = NOTE_ALREADY_FILLED,
+        [MOVE_BREAKS_RULES]   = NOTE_BREAKS_RULES,
+    };
+
+    if (r < 0) {
+        room_note(room, NOTE_BAD_FORMAT);
+        room_next_turn(room);
+        return;
+    }
+
+    MoveStatus status = game_validate_move(&room->game, r, c, v);
+    if (status != MOVE_OK) {
+        room_note(room, rejections[status]);
+        room_next_turn(room);
+        return;
+    }
+
+    if (game_solution_at(&room->game, r, c) == v) {
+        game_place(&room->game, r, c, v);
+        room->scores[room->turn]++;
+        room_note(room, NOTE_CORRECT);
+        room_say(room, PROTO_DELTA, "SET %c%d=%d\nSCORE %d %d\n",
+                 'A' + r, c + 1, v, room->turn + 1, room->scores[room->turn]);
+        room_emit(room, MSG_SET, 2, r * BOARDSIZE + c, v);
+        room_emit(room, MSG_SCORE, 3, room->turn + 1,
+                  room->scores[room->turn] >> 8, room->scores[room->turn] & 0xFF);
+    } else {
+        room_note(room, NOTE_WRONG);
+    }
+
+    room_next_turn(room);
+}
+
+// room_handle_move(), timed from the move being parsed until the next
+// turn has been handed to the sockets
+static void room_on_move(Room *room, int r, int c, int v)
+{
+    MetricsShard *m = room->reactor->metrics;
+    uint64_t start = time_now_ns();
+
+    room->turn_ended_ns = start;
+    room_handle_move(room, r, c, v);
+    metrics_count(m, METRIC_MOVES, 1);
+    metrics_latency(m, LATENCY_MOVE, time_now_ns() - start);
+}
+
+// Player 1's menu choice; '\0' for an empty answer
+static void room_handle_menu(Room *room, char choice)
+{
+    if (choice == '\0') {
+        room_note(room, NOTE_MENU_INVALID);
+        room_show_menu(room);
+        return;
+    }
+
+    choice = (char)toupper((unsigned char)choice);
+
+    if (choice == 'R') {
+        room_note(room, NOTE_REPLAY);
+        room_start_exercise(room);
+    } else if (choice == 'N') {
+        room_note(room, NOTE_NEXT);
+        room_new_puzzle(room);
+    } else if (choice == 'Q') {
+        room_note(room, NOTE_BYE);
+        room_close(room);
+    } else {
+        room_note(room, NOTE_MENU_CHOICE);
+        room_show_menu(room);
+    }
+}
+
+static void room_start_game(Room *room)
+{
+    // A player who did not mind plays what the other one asked for; the
+    // turn length is player 1's choice if they made one
+    if (room->difficulty == DIFFICULTY_ANY)
+        room->difficulty = room->players[1]->difficulty;
+    room->turn_seconds = room->players[0]->turn_seconds ? room->players[0]->turn_seconds
+                       : room->players[1]->turn_seconds ? room->players[1]->turn_seconds
+                       : room->reactor->opt->turn_seconds;
+    conn_touch(room->players[0]);
+    conn_touch(room->players[1]);
+
+    printf("SERVER: room %d started (%s)\n", room->id, difficulty_name(room->difficulty));
+    fflush(stdout);
+    atomic_store(&room->reactor->server->last_started, room->id);
+    metrics_count(room->reactor->metrics, METRIC_GAMES, 1);
+
+    room_say(room, PROTO_TEXT, PROTO_TEXT_INTRO, room->turn_seconds);
+    room_say(room, PROTO_DELTA, "RULES %d\n", room->turn_seconds);
+    room_emit(room, MSG_RULES, 2, room->turn_seconds >> 8, room->turn_seconds & 0xFF);
+
+    room_new_puzzle(room);
+}
+
+// A player left: tell the other one and end the room
+static void room_player_gone(Room *room, int slot)
+{
+    room->players[slot]->room = NULL;
+    room->players[slot] = NULL;
+
+    if (room->phase == ROOM_WAITING) {
+        room_abandon(room);
+        return;
+    }
+
+    if (room->phase == ROOM_MENU && slot == 0)
+        room_say(room, PROTO_TEXT, PROTO_TEXT_LEFT_MENU);
+    else
+        room_say(room, PROTO_TEXT, PROTO_TEXT_LEFT, slot + 1);
+    room_say(room, PROTO_DELTA, "LEFT %d\n", slot + 1);
+    room_emit(room, MSG_LEFT, 1, slot + 1);
+
+    room_close(room);
+}
+
+// Input from a player who is not being asked is dropped, as the blocking
+// server used to flush it before each prompt. Spectators are never asked.
+static bool room_expects_move(const Room *room, const Conn *c)
+{
+    return room->phase == ROOM_TURN && !c->spectating && c->slot == room->turn;
+}
+
+static bool room_expects_choice(const Room *room, const Conn *c)
+{
+    return room->phase == ROOM_MENU && !c->spectating && c->slot == 0;
+}
+
+static void room_on_line(Room *room, Conn *c, const char *line)
+{
+    if (room_expects_move(room, c)) {
+        int r, col = 0, v = 0;
+        if (!proto_parse_move(line, &r, &col, &v))
+            r = -1;
+        room_on_move(room, r, col, v);
+    } else if (room_expects_choice(room, c)) {
+        char choice;
+        if (sscanf(line, " %c", &choice) != 1)
+            choice = '\0';
+        room_handle_menu(room, choice);
+    }
+}
+
+static void room_on_frame(Room *room, Conn *c, const uint8_t *frame, size_t size)
+{
+    const uint8_t *payload = frame + PROTO_HEADER;
+    size_t len = size - PROTO_HEADER;
+
+    if (frame[0] == MSG_MOVE && room_expects_move(room, c)) {
+        bool ok = len == 2 && payload[0] < BOARD_LINE_LEN && payload[1] >= 1 && payload[1] <= 9;
+        room_on_move(room, ok ? payload[0] / BOARDSIZE : -1,
+                     ok ? payload[0] % BOARDSIZE : -1, ok ? payload[1] : 0);
+    } else if (frame[0] == MSG_CHOICE && room_expects_choice(room, c)) {
+        room_handle_menu(room, len == 1 ? (char)payload[0] : '\0');
+    }
+}
+
+// Seats c, already attached to the room's reactor
+static void room_join(Room *room, Conn *c)
+{
+    int slot = room->players[0] ? 1 : 0;
+
+    room->players[slot] = c;
+    room->modes |= 1u << c->mode;
+    c->room = room;
+    c->slot = slot;
+
+    if (c->mode == PROTO_BINARY) {
+        uint8_t msg[PROTO_HEADER + 1];
+        uint8_t player = (uint8_t)(slot + 1);
+        conn_write(c, (const char *)msg, proto_encode(msg, MSG_PLAYER, &player, 1));
+    } else {
+        char msg[64];
+        snprintf(msg, sizeof(msg), "YOU_ARE_PLAYER %d\n", slot + 1);
+        conn_puts(c, msg);
+    }
+    room_say(room, PROTO_TEXT, PROTO_TEXT_JOINED, slot + 1);
+    room_say(room, PROTO_DELTA, "JOINED %d\n", slot + 1);
+    room_emit(room, MSG_JOINED, 1, slot + 1);
+
+    if (slot == 1)
+        room_start_game(room);
+    else
+        room_flush(room);
+}
+
+// Everything a spectator arriving mid-game needs to catch up: which room
+// it is watching, the board as it stands, the scores and whose move it is
+static void room_snapshot(const Room *room, ProtoMode mode, Frame *f)
+{
+    Board b;
+    game_to_board(&room->game, b);
+
+    if (mode == PROTO_TEXT) {
+        frame_printf(f, "Watching room %d.\n", room->id);
+        if (room->phase == ROOM_TURN) {
+            frame_printf(f, PROTO_TEXT_TURN, room->turn + 1, room->scores[0], room->scores[1]);
+            frame_render_game(f, &room->game);
+        } else {
+            frame_render_game(f, &room->game);
+            frame_printf(f, PROTO_TEXT_SCORES, room->scores[0], room->scores[1]);
+            frame_printf(f, PROTO_TEXT_MENU);
+        }
+    } else if (mode == PROTO_DELTA) {
+        char line[BOARD_LINE_LEN + 1];
+        board_to_line(b, line);
+        frame_printf(f, "SPECTATING %d\nPUZZLE %s\nSCORE 1 %d\nSCORE 2 %d\n",
+                     room->id, line, room->scores[0], room->scores[1]);
+        if (room->phase == ROOM_TURN)
+            frame_printf(f, "TURN %d\n", room->turn + 1);
+        else
+            frame_printf(f, "MENU\n");
+    } else {
+        uint8_t id[4] = {
+            (uint8_t)(room->id >> 24), (uint8_t)(room->id >> 16),
+            (uint8_t)(room->id >> 8), (uint8_t)room->id
+        };
+        uint8_t packed[PROTO_BOARD_BYTES];
+        proto_pack_board(b, packed);
+        frame_encode(f, MSG_SPECTATING, id, sizeof(id));
+        frame_encode(f, MSG_PUZZLE, packed, sizeof(packed));
+        for (int i = 0; i < 2; i++) {
+            uint8_t score[3] = {
+                (uint8_t)(i + 1), (uint8_t)(room->scores[i] >> 8), (uint8_t)room->scores[i]
+            };
+            frame_encode(f, MSG_SCORE, score, sizeof(score));
+        }
+        if (room->phase == ROOM_TURN) {
+            uint8_t player = (uint8_t)(room->turn + 1);
+            frame_encode(f, MSG_TURN, &player, 1);
+        } else {
+            frame_encode(f, MSG_MENU, NULL, 0);
+        }
+    }
+}
+
+// Adds c, attached to r, as a spectator of room c->watch_id. Spectator
+// joins are rare next to moves, so the room is found by walking r's list.
+static void room_watch(Reactor *r, Conn *c)
+{
+    Room *room = r->rooms;
+    while (room && room->id != c->watch_id)
+        room = room->next;
+
+    if (!room || room->phase == ROOM_WAITING) {
+        static const uint8_t bin_no_game[PROTO_HEADER] = { MSG_NO_GAME, 0, 0 };
+        if (c->mode == PROTO_BINARY)
+            conn_write(c, (const char *)bin_no_game, sizeof(bin_no_game));
+        else
+            conn_puts(c, c->mode == PROTO_DELTA ? "NO_GAME\n" : "No such game to watch.\n");
+        conn_finish(c);
+        return;
+    }
+
+    if (room->nspectators == room->spectators_cap) {
+        size_t cap = room->spectators_cap ? room->spectators_cap * 2 : 8;
+        Conn **grown = realloc(room->spectators, cap * sizeof(*grown));
+        if (!grown) {
+            conn_close(c);
+            return;
+        }
+        room->spectators = grown;
+        room->spectators_cap = cap;
+    }
+    c->room = room;
+    c->slot = (int)room->nspectators;
+    room->spectators[room->nspectators++] = c;
+    room->audience[c->mode]++;
+    metrics_gauge(r->metrics, GAUGE_SPECTATORS, 1);
+
+    Frame f = { 0 };
+    room_snapshot(room, c->mode, &f);
+    conn_write(c, f.data, f.len);
+    free(f.data);
+}
+
+static void room_unwatch(Room *room, Conn *c)
+{
+    Conn *last = room->spectators[--room->nspectators];
+    room->spectators[c->slot] = last;
+    last->slot = c->slot;
+    room->audience[c->mode]--;
+    metrics_gauge(room->reactor->metrics, GAUGE_SPECTATORS, -1);
+    c->room = NULL;
+}
+
+// The current turn ran out, or player 1 left the menu unanswered
+static void room_on_timer(Timer *t)
+{
+    Room *room = t->arg;
+
+    if (room->phase == ROOM_TURN) {
+        room->turn_ended_ns = time_now_ns();
+        room_note(room, NOTE_TIMEOUT);
+        room_next_turn(room);
+    } else if (room->phase == ROOM_MENU) {
+        room_note(room, NOTE_MENU_TIMEOUT);
+        room_close(room);
+    }
+}
+
+// ---- reactors ----
+
+static void mailbox_wake(Mailbox *mb)
+{
+#ifndef _WIN32
+    char byte = 1;
+    ssize_t n = write(mb->wake[1], &byte, 1);
+    (void)n;    // a full pipe already means "wake up"
+#else
+    (void)mb;
+#endif
+}
+
+static bool mailbox_push(Mailbox *mb, Handoff h)
+{
+    pthread_mutex_lock(&mb->lock);
+    if (mb->len == mb->cap) {
+        size_t cap = mb->cap ? mb->cap * 2 : 16;
+        Handoff *grown = realloc(mb->items, cap * sizeof(*grown));
+        if (!grown) {
+            pthread_mutex_unlock(&mb->lock);
+            return false;
+        }
+        mb->items = grown;
+        mb->cap = cap;
+    }
+    mb->items[mb->len++] = h;
+    pthread_mutex_unlock(&mb->lock);
+
+    mailbox_wake(mb);
+    return true;
+}
+
+// Passes a detached connection to another reactor. From here on only
+// `to` may touch it.
+static void reactor_handoff(Reactor *from, Reactor *to, Conn *c, Room *room)
+{
+    Handoff h = { c, room };
+    if (mailbox_push(&to->mailbox, h))
+        return;
+
+    // Still ours: close it here
+    close(c->fd);
+    c->fd = -1;
+    c->next_dead = from->dead;
+    from->dead = c;
+
+    if (room) {
+        // Give the waiting room back to the lobby if it is still free
+        Server *s = to->server;
+        pthread_mutex_lock(&s->lobby_lock);
+        if (!s->lobby[room->difficulty])
+            s->lobby[room->difficulty] = room;
+        pthread_mutex_unlock(&s->lobby_lock);
+    }
+}
+
+// Waiting room a player asking for d can join, or NULL: a room waiting on
+// the same difficulty or with no preference, or any room if d is
+// DIFFICULTY_ANY. Among those the oldest (lowest id) goes first, so
+// players are paired in arrival order.
+static Room **lobby_match(Server *s, Difficulty d)
+{
+    Room **best = NULL;
+
+    for (int i = 0; i < LOBBY_QUEUES; i++) {
+        bool fits = d == DIFFICULTY_ANY || i == (int)d || i == DIFFICULTY_ANY;
+        if (fits && s->lobby[i] && (!best || s->lobby[i]->id < (*best)->id))
+            best = &s->lobby[i];
+    }
+    return best;
+}
+
+// Pairs a connection that finished its handshake with a lobby room,
+// wherever it lives, or opens a new lobby room on this reactor
+static void reactor_add_player(Reactor *r, Conn *c)
+{
+    Server *s = r->server;
+    Room *room;
+
+    pthread_mutex_lock(&s->lobby_lock);
+    Room **slot = lobby_match(s, c->difficulty);
+    if (slot) {
+        room = *slot;
+        *slot = NULL;
+    } else {
+        s->lobby[c->difficulty] = room = room_create(r, c->difficulty);
+    }
+    pthread_mutex_unlock(&s->lobby_lock);
+
+    if (!room) {
+        conn_close(c);
+        return;
+    }
+
+    if (room->reactor == r) {
+        room_join(room, c);
+    } else {
+        conn_detach(c);
+        reactor_handoff(r, room->reactor, c, room);
+    }
+}
+
+// Sends a spectator to the reactor that owns the room it asked for, or the
+// newest game if it named none
+static void reactor_add_spectator(Reactor *r, Conn *c)
+{
+    Server *s = r->server;
+
+    if (c->watch_id <= 0)
+        c->watch_id = atomic_load(&s->last_started);
+
+    Reactor *home = c->watch_id > 0 ? &s->reactors[c->watch_id % s->nreactors] : r;
+    if (home == r) {
+        room_watch(r, c);
+    } else {
+        conn_detach(c);
+        reactor_handoff(r, home, c, NULL);
+    }
+}
+
+// A new connection has HANDSHAKE_GRACE_MS to send "HELLO mode=..."; one
+// that stays silent, like older clients that only speak when prompted,
+// gets text mode
+static void handshake_begin(Reactor *r, Conn *c)
+{
+    timerwheel_add(&r->timers, &c->timer, time_now_ns() + (uint64_t)HANDSHAKE_GRACE_MS * 1000000u);
+}
+
+// hello is the client's HELLO line, or NULL if it did not send one. May
+// hand c to another reactor: the caller must not touch c afterwards.
+static void handshake_end(Conn *c, const char *hello)
+{
+    ProtoMode mode = PROTO_TEXT;
+    int version = PROTO_VERSION;
+
+    timerwheel_cancel(&c->reactor->timers, &c->timer);
+    c->state = CONN_READY;
+
+    if (hello) {
+        char buf[LINE_MAX_LEN];
+        snprintf(buf, sizeof(buf), "%s", hello);
+        for (char *tok = strtok(buf, " "); tok; tok = strtok(NULL, " ")) {
+            if (strncmp(tok, "mode=", 5) == 0 && !proto_mode_from_name(tok + 5, &mode))
+                mode = PROTO_TEXT;
+            else if (strncmp(tok, "version=", 8) == 0 && atoi(tok + 8) < version)
+                version = atoi(tok + 8);
+            else if (strncmp(tok, "difficulty=", 11) == 0 && !difficulty_from_name(tok + 11, &c->difficulty))
+                c->difficulty = DIFFICULTY_ANY;
+            else if (strcmp(tok, "role=spectate") == 0)
+                c->spectating = true;
+            else if (strncmp(tok, "room=", 5) == 0)
+                c->watch_id = atoi(tok + 5);
+            else if (strncmp(tok, "turn=", 5) == 0 && atoi(tok + 5) > 0)
+                c->turn_seconds = atoi(tok + 5) < MAX_TURN_SECONDS ? atoi(tok + 5) : MAX_TURN_SECONDS;
+        }
+
+        // Binary is version 1 onwards; older peers get a line protocol
+        if (mode == PROTO_BINARY && version < 1)
+            mode = PROTO_DELTA;
+
+        char reply[112];
+        snprintf(reply, sizeof(reply), "WELCOME mode=%s version=%d difficulty=%s%s\n",
+                 proto_mode_name(mode), version, difficulty_name(c->difficulty),
+                 c->spectating ? " role=spectate" : "");
+        conn_puts(c, reply);
+    }
+    c->mode = mode;
+
+    // Anything else sent before the game asks for input is ignored
+    if (mode == PROTO_BINARY) {
+        size_t pending;
+        linebuf_peek(&c->in, &pending);
+        linebuf_consume(&c->in, pending);
+    } else {
+        while (linebuf_next(&c->in, NULL))
+            ;
+    }
+
+    if (c->fd < 0)
+        return;
+    if (c->spectating)
+        reactor_add_spectator(c->reactor, c);
+    else
+        reactor_add_player(c->reactor, c);
+}
+
+// Grace period over for a silent client or a closing one, or a seated
+// player idle too long
+static void conn_on_timer(Timer *t)
+{
+    Conn *c = t->arg;
+
+    if (c->closing) {
+        conn_close(c);
+    } else if (c->state == CONN_HANDSHAKE) {
+        handshake_end(c, NULL);
+    } else if (c->room && !c->spectating) {
+        printf("SERVER: room %d: player %d idle for %d s, disconnecting\n",
+               c->room->id, c->slot + 1, conn_idle_seconds(c));
+        fflush(stdout);
+        metrics_count(c->reactor->metrics, METRIC_IDLE_PLAYERS, 1);
+        conn_abort(c);
+    }
+}
+
+static void reactor_drain_mailbox(Reactor *r)
+{
+    Mailbox *mb = &r->mailbox;
+    Handoff *items;
+    size_t len;
+
+#ifndef _WIN32
+    char buf[64];
+    while (read(mb->wake[0], buf, sizeof(buf)) > 0)
+        ;
+#endif
+
+    pthread_mutex_lock(&mb->lock);
+    items = mb->items;
+    len = mb->len;
+    mb->items = NULL;
+    mb->len = mb->cap = 0;
+    pthread_mutex_unlock(&mb->lock);
+
+    for (size_t i = 0; i < len; i++) {
+        Handoff h = items[i];
+
+        if (h.room && !h.room->players[0]) {
+            // Its player left while this one was on the way
+            room_free(h.room);
+            h.room = NULL;
+        }
+
+        if (!conn_attach(r, h.conn)) {
+            if (h.room)
+                room_close(h.room);
+            continue;
+        }
+
+        if (h.conn->state == CONN_HANDSHAKE)
+            handshake_begin(r, h.conn);
+        else if (h.conn->spectating)
+            room_watch(r, h.conn);
+        else if (h.room)
+            room_join(h.room, h.conn);
+        else
+            reactor_add_player(r, h.conn);
+    }
+    free(items);
+}
+
+// ---- connection input ----
+
+static void conn_on_disconnect(Conn *c)
+{
+    if (c->room && c->spectating)
+        room_unwatch(c->room, c);
+    else if (c->room)
+        room_player_gone(c->room, c->slot);
+    conn_close(c);
+}
+
+// Handles every complete frame buffered; false if c was dropped for
+// sending an oversized one
+static bool conn_read_frames(Conn *c)
+{
+    while (c->fd >= 0 && !c->closing) {
+        size_t avail;
+        const uint8_t *buf = (const uint8_t *)linebuf_peek(&c->in, &avail);
+        long size = proto_frame_size(buf, avail);
+
+        if (size == 0)
+            return true;
+        if (size < 0) {
+            conn_on_disconnect(c);
+            return false;
+        }
+
+        if (c->room)
+            room_on_frame(c->room, c, buf, (size_t)size);
+        linebuf_consume(&c->in, (size_t)size);
+    }
+    return true;
+}
+
+// A closing connection's input is read and dropped: left unread, a peer
+// that keeps sending or hangs up keeps the socket readable and the loop
+// spinning
+static void conn_discard_input(Conn *c)
+{
+    while (c->fd >= 0) {
+        long n = linebuf_fill(&c->in, c->fd);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+            conn_close(c);
+            return;
+        }
+        if (n < 0)
+            return;
+
+        size_t avail;
+        linebuf_peek(&c->in, &avail);
+        linebuf_consume(&c->in, avail);
+    }
+}
+
+static void conn_on_readable(Conn *c)
+{
+    if (c->closing) {
+        conn_discard_input(c);
+        return;
+    }
+
+    while (c->fd >= 0 && !c->closing) {
+        long n = linebuf_fill(&c->in, c->fd);
+        if (n == 0) {
+            conn_on_disconnect(c);
+            return;
+        }
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                conn_on_disconnect(c);
+            return;
+        }
+        metrics_count(c->reactor->metrics, METRIC_BYTES_IN, (uint64_t)n);
+        conn_touch(c);
+
+        if (c->state == CONN_READY && c->mode == PROTO_BINARY) {
+            if (!conn_read_frames(c))
+                return;
+            continue;
+        }
+
+        char *line;
+        while (c->fd >= 0 && !c->closing && (line = linebuf_next(&c->in, NULL))) {
+            if (c->state == CONN_HANDSHAKE) {
+                handshake_end(c, strncmp(line, "HELLO", 5) == 0 ? line : NULL);
+                return;
+            }
+            if (c->room)
+                room_on_line(c->room, c, line);
+        }
+    }
+}
+
+// On Linux every reactor accepts on its own SO_REUSEPORT listener;
+// elsewhere reactor 0 accepts for all and deals connections out round-robin
+static void reactor_accept(Reactor *r)
+{
+    Server *s = r->server;
+
+    for (;;) {
+        int fd = accept(r->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                perror("accept");
+            return;
+        }
+
+        Conn *c = conn_create(fd);
+        if (!c)
+            continue;
+        metrics_count(r->metrics, METRIC_CONNECTIONS, 1);
+        metrics_gauge(r->metrics, GAUGE_CONNECTIONS, 1);
+
+        Reactor *to = r;
+        if (!s->shared_listen)
+            to = &s->reactors[r->next_target++ % (unsigned)s->nreactors];
+
+        if (to != r) {
+            c->reactor = r;
+            reactor_handoff(r, to, c, NULL);
+        } else if (conn_attach(r, c)) {
+            handshake_begin(r, c);
+        }
+    }
+}
+
+static void reactor_free_dead(Reactor *r)
+{
+    while (r->dead) {
+        Conn *c = r->dead;
+        r->dead = c->next_dead;
+        metrics_gauge(r->metrics, GAUGE_CONNECTIONS, -1);
+        linebuf_free(&c->in);
+        outq_free(&c->out);
+        free(c);
+    }
+}
+
+// One log line with the send queue counters, if anything happened since
+// the last one
+static void server_report_queues(Server *s)
+{
+    unsigned long long backlogged = metrics_total(METRIC_SEND_BACKLOGS);
+    unsigned long long resyncs = metrics_total(METRIC_RESYNCS);
+    unsigned long long slow = metrics_total(METRIC_SLOW_PLAYERS);
+    unsigned long long skipped = metrics_total(METRIC_SKIPPED_BYTES);
+    long long peak = metrics_gauge_value(GAUGE_QUEUE_PEAK);
+
+    if (backlogged + resyncs + slow == s->reported)
+        return;
+    s->reported = backlogged + resyncs + slow;
+
+    printf("SERVER: send queues: %llu backlogged sends, deepest %lld bytes, "
+           "%llu spectator resyncs (%llu bytes skipped), %llu slow players dropped\n",
+           backlogged, peak, resyncs, skipped, slow);
+    fflush(stdout);
+}
+
+static void *reactor_main(void *arg)
+{
+    Reactor *r = arg;
+    EvEvent events[MAX_EVENTS];
+    uint64_t last_tick = time_now_ns();
+    uint64_t last_report = last_tick;
+
+    for (;;) {
+        int timeout = timerwheel_timeout_ms(&r->timers, time_now_ns(), TICK_MS);
+        int n = evloop_wait(r->loop, events, MAX_EVENTS, timeout);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("evloop_wait");
+            return NULL;
+        }
+
+        for (int i = 0; i < n; i++) {
+            if (events[i].data == &r->listen_fd) {
+                reactor_accept(r);
+                continue;
+            }
+            if (events[i].data == &r->mailbox) {
+                reactor_drain_mailbox(r);
+                continue;
+            }
+
+            Conn *c = events[i].data;
+            if (c->fd >= 0 && (events[i].events & EV_WRITE))
+                conn_on_writable(c);
+            // Reading last: it may hand c over to another reactor
+            if (c->fd >= 0 && (events[i].events & (EV_READ | EV_ERROR)))
+                conn_on_readable(c);
+        }
+
+        uint64_t now = time_now_ns();
+        timerwheel_advance(&r->timers, now);
+#ifdef _WIN32
+        if (now - last_tick >= (uint64_t)TICK_MS * 1000000u) {
+            reactor_drain_mailbox(r);
+            last_tick = now;
+        }
+#endif
+        if (r->index == 0 && now - last_report >= (uint64_t)QUEUE_REPORT_MS * 1000000u) {
+            server_report_queues(r->server);
+            last_report = now;
+        }
+
+        reactor_free_dead(r);
+    }
+}
+
+static bool reactor_init(Reactor *r, Server *s, int listen_fd)
+{
+    r->server = s;
+    r->opt = s->opt;
+    r->index = (int)(r - s->reactors);
+    r->metrics = metrics_shard(r->index);
+    r->listen_fd = listen_fd;
+    r->mailbox.wake[0] = r->mailbox.wake[1] = -1;
+    pthread_mutex_init(&r->mailbox.lock, NULL);
+    timerwheel_init(&r->timers, time_now_ns(), TIMER_TICK_MS);
+    gen_rng_seed(&r->rng, (uint64_t)time(NULL) ^ time_now_ns() ^ (uint64_t)r->index << 48);
+
+    r->loop = evloop_create();
+    if (!r->loop)
+        return false;
+
+    if (listen_fd >= 0 &&
+        (net_set_nonblocking(listen_fd) < 0 ||
+         evloop_add(r->loop, listen_fd, EV_READ, &r->listen_fd) < 0))
+        return false;
+
+#ifndef _WIN32
+    if (pipe(r->mailbox.wake) < 0 ||
+        net_set_nonblocking(r->mailbox.wake[0]) < 0 ||
+        net_set_nonblocking(r->mailbox.wake[1]) < 0 ||
+        evloop_add(r->loop, r->mailbox.wake[0], EV_READ, &r->mailbox) < 0)
+        return false;
+#endif
+    return true;
+}
+
+int run_server(const ServerOptions *opt)
+{
+#ifndef _WIN32
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    if (generator_open("sudoku.csv"))
+        printf("SERVER: Loaded puzzle file sudoku.csv\n");
+    else
+        printf("SERVER: sudoku.csv not available, generating puzzles\n");
+
+    if (!prompts_init()) {
+        perror("malloc");
+        return 1;
+    }
+
+    Server s = {0};
+    s.opt = opt;
+    s.nreactors = opt->threads > 0 ? opt->threads : pool_cpu_count();
+    s.reactors = calloc((size_t)s.nreactors, sizeof(Reactor));
+    pthread_mutex_init(&s.lobby_lock, NULL);
+    if (!s.reactors || !metrics_init(s.nreactors)) {
+        perror("calloc");
+        return 1;
+    }
+
+    // One listener per reactor if the kernel balances them, else one
+    // shared by dealing from reactor 0
+    int first = s.nreactors > 1 ? net_listen_shared(opt->port) : -1;
+    s.shared_listen = first >= 0;
+    if (!s.shared_listen)
+        first = net_listen(opt->port);
+
+    for (int i = 0; i < s.nreactors; i++) {
+        int fd = -1;
+        if (i == 0)
+            fd = first;
+        else if (s.shared_listen)
+            fd = net_listen_shared(opt->port);
+
+        if ((i == 0 || s.shared_listen) && fd < 0) {
+            fprintf(stderr, "SERVER: could not listen on port %d\n", opt->port);
+            return 1;
+        }
+        if (!reactor_init(&s.reactors[i], &s, fd)) {
+            fprintf(stderr, "SERVER: could not set up reactor %d\n", i);
+            return 1;
+        }
+    }
+
+    if (opt->admin_port > 0) {
+        if (!metrics_serve(opt->admin_port)) {
+            fprintf(stderr, "SERVER: could not listen on admin port %d\n", opt->admin_port);
+            return 1;
+        }
+        printf("SERVER: Metrics on http://127.0.0.1:%d/metrics\n", opt->admin_port);
+    }
+
+    g_prefetch[DIFFICULTY_ANY] = prefetch_start(PREFETCH_PUZZLES, prefetch_source_generator, NULL);
+    for (int d = DIFFICULTY_EASY; d < LOBBY_QUEUES; d++)
+        g_prefetch[d] = prefetch_start(PREFETCH_LEVEL, prefetch_source_difficulty, &g_levels[d]);
+
+    printf("SERVER: Waiting for players on port %d (%d reactor thread%s)...\n",
+           opt->port, s.nreactors, s.nreactors == 1 ? "" : "s");
+    fflush(stdout);
+
+    for (int i = 1; i < s.nreactors; i++) {
+        if (pthread_create(&s.reactors[i].thread, NULL, reactor_main, &s.reactors[i]) != 0) {
+            perror("pthread_create");
+            return 1;
+        }
+    }
+    reactor_main(&s.reactors[0]);
+
+    for (int d = 0; d < LOBBY_QUEUES; d++)
+        prefetch_stop(g_prefetch[d]);
+    return 1;
+}
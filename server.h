@@ -0,0 +1,25 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdbool.h>
+
+typedef struct {
+    int port;
+    int turn_seconds;   // unless the room's first player asks for another
+    int menu_seconds;   // for player 1's R/N/Q before the room ends
+    int idle_seconds;   // a seated player who sends nothing is dropped
+    int threads;        // reactor threads, 0 = one per CPU
+    int admin_port;     // metrics on 127.0.0.1, 0 = none
+} ServerOptions;
+
+void server_default_options(ServerOptions *opt);
+
+// Parses "[PORT] [--turn-seconds N] [--menu-seconds N] [--idle-seconds N]
+// [--threads N] [--admin-port N]". Returns false on bad input.
+bool server_parse_options(ServerOptions *opt, int argc, char *argv[]);
+
+// Hosts any number of two-player rooms on opt->threads event loops.
+// Returns only if the listeners cannot be set up.
+int run_server(const ServerOptions *opt);
+
+#endif //SERVER_H
@@ -1,4 +1,194 @@
 #include "solver.h"
+#include "dlx.h"
+#include "timeutil.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static SolverEngine g_engine = SOLVER_MRV;
+
+_Thread_local SolverStats solver_thread_stats;
+_Thread_local FILE *solver_trace_file;
+
+static const char *const engine_names[] = {
+    [SOLVER_BACKTRACK] = "backtrack",
+    [SOLVER_DLX]       = "dlx",
+    [SOLVER_MRV]       = "mrv"
+};
+
+const uint8_t solver_cell_row[SOLVER_CELLS] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0,
+    1, 1, 1, 1, 1, 1, 1, 1, 1,
+    2, 2, 2, 2, 2, 2, 2, 2, 2,
+    3, 3, 3, 3, 3, 3, 3, 3, 3,
+    4, 4, 4, 4, 4, 4, 4, 4, 4,
+    5, 5, 5, 5, 5, 5, 5, 5, 5,
+    6, 6, 6, 6, 6, 6, 6, 6, 6,
+    7, 7, 7, 7, 7, 7, 7, 7, 7,
+    8, 8, 8, 8, 8, 8, 8, 8, 8,
+};
+
+const uint8_t solver_cell_col[SOLVER_CELLS] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8,
+    0, 1, 2, 3, 4, 5, 6, 7, 8,
+    0, 1, 2, 3, 4, 5, 6, 7, 8,
+    0, 1, 2, 3, 4, 5, 6, 7, 8,
+    0, 1, 2, 3, 4, 5, 6, 7, 8,
+    0, 1, 2, 3, 4, 5, 6, 7, 8,
+    0, 1, 2, 3, 4, 5, 6, 7, 8,
+    0, 1, 2, 3, 4, 5, 6, 7, 8,
+    0, 1, 2, 3, 4, 5, 6, 7, 8,
+};
+
+const uint8_t solver_cell_box[SOLVER_CELLS] = {
+    0, 0, 0, 1, 1, 1, 2, 2, 2,
+    0, 0, 0, 1, 1, 1, 2, 2, 2,
+    0, 0, 0, 1, 1, 1, 2, 2, 2,
+    3, 3, 3, 4, 4, 4, 5, 5, 5,
+    3, 3, 3, 4, 4, 4, 5, 5, 5,
+    3, 3, 3, 4, 4, 4, 5, 5, 5,
+    6, 6, 6, 7, 7, 7, 8, 8, 8,
+    6, 6, 6, 7, 7, 7, 8, 8, 8,
+    6, 6, 6, 7, 7, 7, 8, 8, 8,
+};
+
+// The 20 other cells sharing a row, column or box with each cell
+const uint8_t solver_peers[SOLVER_CELLS][SOLVER_PEERS] = {
+    { 1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 18, 19, 20, 27, 36, 45, 54, 63, 72},
+    { 0,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 18, 19, 20, 28, 37, 46, 55, 64, 73},
+    { 0,  1,  3,  4,  5,  6,  7,  8,  9, 10, 11, 18, 19, 20, 29, 38, 47, 56, 65, 74},
+    { 0,  1,  2,  4,  5,  6,  7,  8, 12, 13, 14, 21, 22, 23, 30, 39, 48, 57, 66, 75},
+    { 0,  1,  2,  3,  5,  6,  7,  8, 12, 13, 14, 21, 22, 23, 31, 40, 49, 58, 67, 76},
+    { 0,  1,  2,  3,  4,  6,  7,  8, 12, 13, 14, 21, 22, 23, 32, 41, 50, 59, 68, 77},
+    { 0,  1,  2,  3,  4,  5,  7,  8, 15, 16, 17, 24, 25, 26, 33, 42, 51, 60, 69, 78},
+    { 0,  1,  2,  3,  4,  5,  6,  8, 15, 16, 17, 24, 25, 26, 34, 43, 52, 61, 70, 79},
+    { 0,  1,  2,  3,  4,  5,  6,  7, 15, 16, 17, 24, 25, 26, 35, 44, 53, 62, 71, 80},
+    { 0,  1,  2, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 27, 36, 45, 54, 63, 72},
+    { 0,  1,  2,  9, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 28, 37, 46, 55, 64, 73},
+    { 0,  1,  2,  9, 10, 12, 13, 14, 15, 16, 17, 18, 19, 20, 29, 38, 47, 56, 65, 74},
+    { 3,  4,  5,  9, 10, 11, 13, 14, 15, 16, 17, 21, 22, 23, 30, 39, 48, 57, 66, 75},
+    { 3,  4,  5,  9, 10, 11, 12, 14, 15, 16, 17, 21, 22, 23, 31, 40, 49, 58, 67, 76},
+    { 3,  4,  5,  9, 10, 11, 12, 13, 15, 16, 17, 21, 22, 23, 32, 41, 50, 59, 68, 77},
+    { 6,  7,  8,  9, 10, 11, 12, 13, 14, 16, 17, 24, 25, 26, 33, 42, 51, 60, 69, 78},
+    { 6,  7,  8,  9, 10, 11, 12, 13, 14, 15, 17, 24, 25, 26, 34, 43, 52, 61, 70, 79},
+    { 6,  7,  8,  9, 10, 11, 12, 13, 14, 15, 16, 24, 25, 26, 35, 44, 53, 62, 71, 80},
+    { 0,  1,  2,  9, 10, 11, 19, 20, 21, 22, 23, 24, 25, 26, 27, 36, 45, 54, 63, 72},
+    { 0,  1,  2,  9, 10, 11, 18, 20, 21, 22, 23, 24, 25, 26, 28, 37, 46, 55, 64, 73},
+    { 0,  1,  2,  9, 10, 11, 18, 19, 21, 22, 23, 24, 25, 26, 29, 38, 47, 56, 65, 74},
+    { 3,  4,  5, 12, 13, 14, 18, 19, 20, 22, 23, 24, 25, 26, 30, 39, 48, 57, 66, 75},
+    { 3,  4,  5, 12, 13, 14, 18, 19, 20, 21, 23, 24, 25, 26, 31, 40, 49, 58, 67, 76},
+    { 3,  4,  5, 12, 13, 14, 18, 19, 20, 21, 22, 24, 25, 26, 32, 41, 50, 59, 68, 77},
+    { 6,  7,  8, 15, 16, 17, 18, 19, 20, 21, 22, 23, 25, 26, 33, 42, 51, 60, 69, 78},
+    { 6,  7,  8, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 26, 34, 43, 52, 61, 70, 79},
+    { 6,  7,  8, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 35, 44, 53, 62, 71, 80},
+    { 0,  9, 18, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 45, 46, 47, 54, 63, 72},
+    { 1, 10, 19, 27, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 45, 46, 47, 55, 64, 73},
+    { 2, 11, 20, 27, 28, 30, 31, 32, 33, 34, 35, 36, 37, 38, 45, 46, 47, 56, 65, 74},
+    { 3, 12, 21, 27, 28, 29, 31, 32, 33, 34, 35, 39, 40, 41, 48, 49, 50, 57, 66, 75},
+    { 4, 13, 22, 27, 28, 29, 30, 32, 33, 34, 35, 39, 40, 41, 48, 49, 50, 58, 67, 76},
+    { 5, 14, 23, 27, 28, 29, 30, 31, 33, 34, 35, 39, 40, 41, 48, 49, 50, 59, 68, 77},
+    { 6, 15, 24, 27, 28, 29, 30, 31, 32, 34, 35, 42, 43, 44, 51, 52, 53, 60, 69, 78},
+    { 7, 16, 25, 27, 28, 29, 30, 31, 32, 33, 35, 42, 43, 44, 51, 52, 53, 61, 70, 79},
+    { 8, 17, 26, 27, 28, 29, 30, 31, 32, 33, 34, 42, 43, 44, 51, 52, 53, 62, 71, 80},
+    { 0,  9, 18, 27, 28, 29, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 54, 63, 72},
+    { 1, 10, 19, 27, 28, 29, 36, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 55, 64, 73},
+    { 2, 11, 20, 27, 28, 29, 36, 37, 39, 40, 41, 42, 43, 44, 45, 46, 47, 56, 65, 74},
+    { 3, 12, 21, 30, 31, 32, 36, 37, 38, 40, 41, 42, 43, 44, 48, 49, 50, 57, 66, 75},
+    { 4, 13, 22, 30, 31, 32, 36, 37, 38, 39, 41, 42, 43, 44, 48, 49, 50, 58, 67, 76},
+    { 5, 14, 23, 30, 31, 32, 36, 37, 38, 39, 40, 42, 43, 44, 48, 49, 50, 59, 68, 77},
+    { 6, 15, 24, 33, 34, 35, 36, 37, 38, 39, 40, 41, 43, 44, 51, 52, 53, 60, 69, 78},
+    { 7, 16, 25, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 44, 51, 52, 53, 61, 70, 79},
+    { 8, 17, 26, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 51, 52, 53, 62, 71, 80},
+    { 0,  9, 18, 27, 28, 29, 36, 37, 38, 46, 47, 48, 49, 50, 51, 52, 53, 54, 63, 72},
+    { 1, 10, 19, 27, 28, 29, 36, 37, 38, 45, 47, 48, 49, 50, 51, 52, 53, 55, 64, 73},
+    { 2, 11, 20, 27, 28, 29, 36, 37, 38, 45, 46, 48, 49, 50, 51, 52, 53, 56, 65, 74},
+    { 3, 12, 21, 30, 31, 32, 39, 40, 41, 45, 46, 47, 49, 50, 51, 52, 53, 57, 66, 75},
+    { 4, 13, 22, 30, 31, 32, 39, 40, 41, 45, 46, 47, 48, 50, 51, 52, 53, 58, 67, 76},
+    { 5, 14, 23, 30, 31, 32, 39, 40, 41, 45, 46, 47, 48, 49, 51, 52, 53, 59, 68, 77},
+    { 6, 15, 24, 33, 34, 35, 42, 43, 44, 45, 46, 47, 48, 49, 50, 52, 53, 60, 69, 78},
+    { 7, 16, 25, 33, 34, 35, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 53, 61, 70, 79},
+    { 8, 17, 26, 33, 34, 35, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 52, 62, 71, 80},
+    { 0,  9, 18, 27, 36, 45, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 65, 72, 73, 74},
+    { 1, 10, 19, 28, 37, 46, 54, 56, 57, 58, 59, 60, 61, 62, 63, 64, 65, 72, 73, 74},
+    { 2, 11, 20, 29, 38, 47, 54, 55, 57, 58, 59, 60, 61, 62, 63, 64, 65, 72, 73, 74},
+    { 3, 12, 21, 30, 39, 48, 54, 55, 56, 58, 59, 60, 61, 62, 66, 67, 68, 75, 76, 77},
+    { 4, 13, 22, 31, 40, 49, 54, 55, 56, 57, 59, 60, 61, 62, 66, 67, 68, 75, 76, 77},
+    { 5, 14, 23, 32, 41, 50, 54, 55, 56, 57, 58, 60, 61, 62, 66, 67, 68, 75, 76, 77},
+    { 6, 15, 24, 33, 42, 51, 54, 55, 56, 57, 58, 59, 61, 62, 69, 70, 71, 78, 79, 80},
+    { 7, 16, 25, 34, 43, 52, 54, 55, 56, 57, 58, 59, 60, 62, 69, 70, 71, 78, 79, 80},
+    { 8, 17, 26, 35, 44, 53, 54, 55, 56, 57, 58, 59, 60, 61, 69, 70, 71, 78, 79, 80},
+    { 0,  9, 18, 27, 36, 45, 54, 55, 56, 64, 65, 66, 67, 68, 69, 70, 71, 72, 73, 74},
+    { 1, 10, 19, 28, 37, 46, 54, 55, 56, 63, 65, 66, 67, 68, 69, 70, 71, 72, 73, 74},
+    { 2, 11, 20, 29, 38, 47, 54, 55, 56, 63, 64, 66, 67, 68, 69, 70, 71, 72, 73, 74},
+    { 3, 12, 21, 30, 39, 48, 57, 58, 59, 63, 64, 65, 67, 68, 69, 70, 71, 75, 76, 77},
+    { 4, 13, 22, 31, 40, 49, 57, 58, 59, 63, 64, 65, 66, 68, 69, 70, 71, 75, 76, 77},
+    { 5, 14, 23, 32, 41, 50, 57, 58, 59, 63, 64, 65, 66, 67, 69, 70, 71, 75, 76, 77},
+    { 6, 15, 24, 33, 42, 51, 60, 61, 62, 63, 64, 65, 66, 67, 68, 70, 71, 78, 79, 80},
+    { 7, 16, 25, 34, 43, 52, 60, 61, 62, 63, 64, 65, 66, 67, 68, 69, 71, 78, 79, 80},
+    { 8, 17, 26, 35, 44, 53, 60, 61, 62, 63, 64, 65, 66, 67, 68, 69, 70, 78, 79, 80},
+    { 0,  9, 18, 27, 36, 45, 54, 55, 56, 63, 64, 65, 73, 74, 75, 76, 77, 78, 79, 80},
+    { 1, 10, 19, 28, 37, 46, 54, 55, 56, 63, 64, 65, 72, 74, 75, 76, 77, 78, 79, 80},
+    { 2, 11, 20, 29, 38, 47, 54, 55, 56, 63, 64, 65, 72, 73, 75, 76, 77, 78, 79, 80},
+    { 3, 12, 21, 30, 39, 48, 57, 58, 59, 66, 67, 68, 72, 73, 74, 76, 77, 78, 79, 80},
+    { 4, 13, 22, 31, 40, 49, 57, 58, 59, 66, 67, 68, 72, 73, 74, 75, 77, 78, 79, 80},
+    { 5, 14, 23, 32, 41, 50, 57, 58, 59, 66, 67, 68, 72, 73, 74, 75, 76, 78, 79, 80},
+    { 6, 15, 24, 33, 42, 51, 60, 61, 62, 69, 70, 71, 72, 73, 74, 75, 76, 77, 79, 80},
+    { 7, 16, 25, 34, 43, 52, 60, 61, 62, 69, 70, 71, 72, 73, 74, 75, 76, 77, 78, 80},
+    { 8, 17, 26, 35, 44, 53, 60, 61, 62, 69, 70, 71, 72, 73, 74, 75, 76, 77, 78, 79},
+};
+
+const uint8_t solver_units[SOLVER_UNITS][BOARDSIZE] = {
+    { 0,  1,  2,  3,  4,  5,  6,  7,  8},
+    { 9, 10, 11, 12, 13, 14, 15, 16, 17},
+    {18, 19, 20, 21, 22, 23, 24, 25, 26},
+    {27, 28, 29, 30, 31, 32, 33, 34, 35},
+    {36, 37, 38, 39, 40, 41, 42, 43, 44},
+    {45, 46, 47, 48, 49, 50, 51, 52, 53},
+    {54, 55, 56, 57, 58, 59, 60, 61, 62},
+    {63, 64, 65, 66, 67, 68, 69, 70, 71},
+    {72, 73, 74, 75, 76, 77, 78, 79, 80},
+    { 0,  9, 18, 27, 36, 45, 54, 63, 72},
+    { 1, 10, 19, 28, 37, 46, 55, 64, 73},
+    { 2, 11, 20, 29, 38, 47, 56, 65, 74},
+    { 3, 12, 21, 30, 39, 48, 57, 66, 75},
+    { 4, 13, 22, 31, 40, 49, 58, 67, 76},
+    { 5, 14, 23, 32, 41, 50, 59, 68, 77},
+    { 6, 15, 24, 33, 42, 51, 60, 69, 78},
+    { 7, 16, 25, 34, 43, 52, 61, 70, 79},
+    { 8, 17, 26, 35, 44, 53, 62, 71, 80},
+    { 0,  1,  2,  9, 10, 11, 18, 19, 20},
+    { 3,  4,  5, 12, 13, 14, 21, 22, 23},
+    { 6,  7,  8, 15, 16, 17, 24, 25, 26},
+    {27, 28, 29, 36, 37, 38, 45, 46, 47},
+    {30, 31, 32, 39, 40, 41, 48, 49, 50},
+    {33, 34, 35, 42, 43, 44, 51, 52, 53},
+    {54, 55, 56, 63, 64, 65, 72, 73, 74},
+    {57, 58, 59, 66, 67, 68, 75, 76, 77},
+    {60, 61, 62, 69, 70, 71, 78, 79, 80},
+};
+
+bool solver_state_init(SolverState *s, const Board b)
+{
+    memset(s, 0, sizeof(*s));
+
+    for (int cell = 0; cell < SOLVER_CELLS; cell++) {
+        int v = b[cell / BOARDSIZE][cell % BOARDSIZE];
+        if (v == 0)
+            continue;
+        if (v < 1 || v > 9)
+            return false;
+        if (!(solver_state_candidates(s, cell) & (1u << (v - 1))))
+            return false; // duplicate given in a row, column or box
+        solver_state_place(s, cell, v);
+    }
+    return true;
+}
+
+void solver_state_to_board(const SolverState *s, Board b)
+{
+    for (int cell = 0; cell < SOLVER_CELLS; cell++)
+        b[cell / BOARDSIZE][cell % BOARDSIZE] = s->cells[cell];
+}
 
 // Check if value can be placed in (row, col)
 int solver_is_safe(const Board b, int row, int col, int value)
@@ -29,41 +219,346 @@ int solver_is_safe(const Board b, int row, int col, int value)
     return 1; // safe
 }
 
-static int find_empty(const Board b, int *row, int *col)
+// Empty cells in row-major order, so the search visits cells in the same
+// order the old find_empty() scan did.
+static int collect_empty(const SolverState *s, uint8_t *empty)
+{
+    int n = 0;
+    for (int cell = 0; cell < SOLVER_CELLS; cell++) {
+        if (s->cells[cell] == 0)
+            empty[n++] = (uint8_t)cell;
+    }
+    return n;
+}
+
+static int search(SolverState *s, const uint8_t *empty, int k, int n)
+{
+    SOLVER_STAT_ADD(nodes, 1);
+    SOLVER_STAT_DEPTH(k);
+
+    if (k == n)
+        return 1; // no empty cells → board is full
+
+    int cell = empty[k];
+    unsigned cand = solver_state_candidates(s, cell);
+
+    while (cand) {
+        int value = solver_lowest_digit(cand) + 1;
+        cand &= cand - 1;
+
+        SOLVER_TRACE(k, "try", cell, value);
+        solver_state_place(s, cell, value);
+        if (search(s, empty, k + 1, n))
+            return 1;
+        solver_state_unplace(s, cell);
+        SOLVER_STAT_ADD(backtracks, 1);
+    }
+
+    return 0;
+}
+
+int solve_board(Board b) {
+    SolverState s;
+    uint8_t empty[SOLVER_CELLS];
+
+    if (!solver_state_init(&s, b))
+        return 0;
+
+    if (!search(&s, empty, 0, collect_empty(&s, empty)))
+        return 0;
+
+    solver_state_to_board(&s, b);
+    return 1;
+}
+
+// Search state for the MRV engine. Every placement is pushed on the trail,
+// so backtracking pops placements instead of copying boards.
+typedef struct {
+    SolverState s;
+    uint8_t trail[SOLVER_CELLS];
+    int ntrail;
+    int depth;                // guesses on the current path
+    int limit;                // stop once this many solutions are found
+    int found;
+    int (*first)[BOARDSIZE];  // receives the first solution, may be NULL
+} MrvSearch;
+
+static void mrv_place(MrvSearch *m, int cell, int value)
+{
+    solver_state_place(&m->s, cell, value);
+    m->trail[m->ntrail++] = (uint8_t)cell;
+}
+
+static void mrv_undo(MrvSearch *m, int mark)
+{
+    while (m->ntrail > mark)
+        solver_state_unplace(&m->s, m->trail[--m->ntrail]);
+}
+
+// Fills naked singles (one candidate left in a cell) and hidden singles
+// (a value with one possible cell in a unit) until nothing changes.
+// Returns false on a contradiction.
+static bool mrv_propagate(MrvSearch *m)
 {
+    bool changed = true;
+
+    while (changed) {
+        changed = false;
+
+        for (int cell = 0; cell < SOLVER_CELLS; cell++) {
+            if (m->s.cells[cell])
+                continue;
+            unsigned cand = solver_state_candidates(&m->s, cell);
+            if (cand == 0)
+                return false;
+            if ((cand & (cand - 1)) == 0) {
+                mrv_place(m, cell, solver_lowest_digit(cand) + 1);
+                changed = true;
+            }
+        }
+
+        for (int u = 0; u < SOLVER_UNITS; u++) {
+            const uint8_t *unit = solver_units[u];
+            unsigned placed = 0, once = 0, twice = 0;
+
+            for (int i = 0; i < BOARDSIZE; i++) {
+                int cell = unit[i];
+                if (m->s.cells[cell]) {
+                    placed |= 1u << (m->s.cells[cell] - 1);
+                    continue;
+                }
+                unsigned cand = solver_state_candidates(&m->s, cell);
+                twice |= once & cand;
+                once  |= cand;
+            }
+
+            if ((placed | once) != SOLVER_ALL_DIGITS)
+                return false; // some value has nowhere to go
+
+            unsigned hidden = once & ~twice;
+            for (int i = 0; hidden && i < BOARDSIZE; i++) {
+                int cell = unit[i];
+                if (m->s.cells[cell])
+                    continue;
+                unsigned hit = solver_state_candidates(&m->s, cell) & hidden;
+                if (hit) {
+                    if (hit & (hit - 1))
+                        return false; // two values forced into one cell
+                    mrv_place(m, cell, solver_lowest_digit(hit) + 1);
+                    hidden &= ~hit;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+// Empty cell with the fewest candidates, or -1 if the board is full
+static int mrv_pick_cell(const MrvSearch *m)
+{
+    int best = -1;
+    int best_count = 10;
+
+    for (int cell = 0; cell < SOLVER_CELLS; cell++) {
+        if (m->s.cells[cell])
+            continue;
+        int count = solver_popcount(solver_state_candidates(&m->s, cell));
+        if (count < best_count) {
+            best = cell;
+            best_count = count;
+            if (count <= 2)
+                break;
+        }
+    }
+    return best;
+}
+
+// Returns 1 once the solution limit is reached. With a limit of 1 the
+// state is left holding the solution.
+static int mrv_search(MrvSearch *m)
+{
+    int mark = m->ntrail;
+
+    SOLVER_STAT_ADD(nodes, 1);
+    SOLVER_STAT_DEPTH(m->depth);
+
+    if (!mrv_propagate(m)) {
+        SOLVER_TRACE(m->depth, "dead-end", -1, m->ntrail - mark);
+        mrv_undo(m, mark);
+        return 0;
+    }
+    SOLVER_STAT_ADD(propagations, (uint64_t)(m->ntrail - mark));
+    if (m->ntrail > mark)
+        SOLVER_TRACE(m->depth, "propagate", -1, m->ntrail - mark);
+
+    int cell = mrv_pick_cell(m);
+    if (cell < 0) {
+        if (m->found++ == 0 && m->first)
+            solver_state_to_board(&m->s, m->first);
+        if (m->found >= m->limit)
+            return 1;
+        mrv_undo(m, mark);
+        return 0;
+    }
+
+    unsigned cand = solver_state_candidates(&m->s, cell);
+    while (cand) {
+        int value = solver_lowest_digit(cand) + 1;
+        cand &= cand - 1;
+
+        int before = m->ntrail;
+        SOLVER_TRACE(m->depth, "try", cell, value);
+        mrv_place(m, cell, value);
+        m->depth++;
+        int stop = mrv_search(m);
+        m->depth--;
+        if (stop)
+            return 1;
+        mrv_undo(m, before);
+        SOLVER_STAT_ADD(backtracks, 1);
+    }
+
+    mrv_undo(m, mark);
+    return 0;
+}
+
+int solve_board_mrv(Board b)
+{
+    MrvSearch m = {0};
+    m.limit = 1;
+
+    if (!solver_state_init(&m.s, b))
+        return 0;
+
+    if (!mrv_search(&m))
+        return 0;
+
+    solver_state_to_board(&m.s, b);
+    return 1;
+}
+
+int solver_count(const Board b, int limit, Board first)
+{
+    MrvSearch m = {0};
+    m.limit = limit > 0 ? limit : 1;
+    m.first = first;
+
+    if (!solver_state_init(&m.s, b))
+        return 0;
+
+    mrv_search(&m);
+    return m.found;
+}
+
+int count_solutions(const Board b, int limit)
+{
+    return solver_count(b, limit, NULL);
+}
+
+bool solver_verify_pair(const Board puzzle, const Board solution)
+{
+    Board first;
+    if (solver_count(puzzle, 2, first) != 1)
+        return false;
+
     for (int r = 0; r < BOARDSIZE; r++) {
         for (int c = 0; c < BOARDSIZE; c++) {
-            if (b[r][c] == 0) {
-                *row = r;
-                *col = c;
-                return 1;
-            }
+            if (first[r][c] != solution[r][c])
+                return false;
         }
     }
-    return 0; // no empty cells → board is full
+    return true;
 }
 
-int solve_board(Board b) {
-    int row, col;
+bool solve_singles(const Board b)
+{
+    MrvSearch m = {0};
 
-    if (!find_empty(b, &row, &col))
-        return 1;
+    if (!solver_state_init(&m.s, b) || !mrv_propagate(&m))
+        return false;
+    return mrv_pick_cell(&m) < 0;
+}
 
-    for (int value = 1; value <= 9; value++) {
-        if (solver_is_safe(b, row, col,value)){
-            b[row][col] = value;
+void solver_set_engine(SolverEngine engine)
+{
+    g_engine = engine;
+}
 
-            if (solve_board(b))
-                return 1;
+SolverEngine solver_get_engine(void)
+{
+    return g_engine;
+}
+
+const char *solver_engine_name(SolverEngine engine)
+{
+    if ((unsigned)engine >= sizeof(engine_names) / sizeof(engine_names[0]))
+        return "unknown";
+    return engine_names[engine];
+}
 
-            b[row][col] = 0;
+bool solver_engine_from_name(const char *name, SolverEngine *out)
+{
+    for (size_t i = 0; i < sizeof(engine_names) / sizeof(engine_names[0]); i++) {
+        if (strcmp(name, engine_names[i]) == 0) {
+            *out = (SolverEngine)i;
+            return true;
         }
     }
+    return false;
+}
 
-    return 0;
+bool solve_with(Board b, SolverEngine engine)
+{
+    // One matrix per thread, built on first use and reused by every solve
+    static _Thread_local DlxSolver dlx;
+
+    switch (engine) {
+        case SOLVER_DLX:
+            return dlx_solve(&dlx, b) != 0;
+        case SOLVER_BACKTRACK:
+            return solve_board(b) != 0;
+        case SOLVER_MRV:
+        default:
+            return solve_board_mrv(b) != 0;
+    }
+}
+
+bool solve_with_stats(Board b, SolverEngine engine, SolverStats *stats)
+{
+    memset(&solver_thread_stats, 0, sizeof(solver_thread_stats));
+
+    uint64_t start = time_now_ns();
+    bool ok = solve_with(b, engine);
+    solver_thread_stats.elapsed_ns = time_now_ns() - start;
+
+    if (stats)
+        *stats = solver_thread_stats;
+    return ok;
+}
+
+void solver_trace_event(int depth, const char *event, int cell, int value)
+{
+    if (cell >= 0)
+        fprintf(solver_trace_file, "%*s%s %c%d=%d\n", 2 * depth, "", event,
+                'A' + cell / BOARDSIZE, cell % BOARDSIZE + 1, value);
+    else
+        fprintf(solver_trace_file, "%*s%s %d\n", 2 * depth, "", event, value);
+}
+
+bool solver_set_trace(FILE *f)
+{
+#ifdef SUDOKU_SOLVER_STATS
+    solver_trace_file = f;
+    return true;
+#else
+    (void)f;
+    return false;
+#endif
 }
 
 bool solve(Board b)
 {
-    return solve_board(b) != 0;
-}
\ No newline at end of file
+    return solve_with(b, g_engine);
+}
@@ -3,15 +3,160 @@
 
 #include "board.h"
 #include <stdbool.h>
+#include <stdint.h>
+
+#define SOLVER_CELLS      (BOARDSIZE * BOARDSIZE)
+#define SOLVER_PEERS      20
+#define SOLVER_UNITS      27
+#define SOLVER_ALL_DIGITS 0x1FF
+
+// Lookup tables indexed by cell number (row * 9 + col)
+extern const uint8_t solver_cell_row[SOLVER_CELLS];
+extern const uint8_t solver_cell_col[SOLVER_CELLS];
+extern const uint8_t solver_cell_box[SOLVER_CELLS];
+extern const uint8_t solver_peers[SOLVER_CELLS][SOLVER_PEERS];
+// 9 rows, then 9 columns, then 9 boxes
+extern const uint8_t solver_units[SOLVER_UNITS][BOARDSIZE];
+
+// Occupancy masks kept in sync with the cells: bit (v - 1) of rows[r] is
+// set when value v is already placed somewhere in row r (same for cols/boxes).
+typedef struct {
+    uint16_t rows[BOARDSIZE];
+    uint16_t cols[BOARDSIZE];
+    uint16_t boxes[BOARDSIZE];
+    uint8_t  cells[SOLVER_CELLS];
+} SolverState;
+
+static inline int solver_popcount(unsigned x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcount(x);
+#else
+    int n = 0;
+    for (; x; x &= x - 1)
+        n++;
+    return n;
+#endif
+}
+
+// Index (0..8) of the lowest set bit, i.e. value - 1
+static inline int solver_lowest_digit(unsigned x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctz(x);
+#else
+    int n = 0;
+    while (!(x & 1u)) {
+        x >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+// Bitmask of values (bit v - 1) that can still go into an empty cell
+static inline uint16_t solver_state_candidates(const SolverState *s, int cell)
+{
+    return (uint16_t)(~(s->rows[solver_cell_row[cell]] |
+                        s->cols[solver_cell_col[cell]] |
+                        s->boxes[solver_cell_box[cell]]) & SOLVER_ALL_DIGITS);
+}
+
+static inline void solver_state_place(SolverState *s, int cell, int value)
+{
+    uint16_t bit = (uint16_t)(1u << (value - 1));
+    s->cells[cell] = (uint8_t)value;
+    s->rows[solver_cell_row[cell]]  |= bit;
+    s->cols[solver_cell_col[cell]]  |= bit;
+    s->boxes[solver_cell_box[cell]] |= bit;
+}
+
+static inline void solver_state_unplace(SolverState *s, int cell)
+{
+    uint16_t bit = (uint16_t)~(1u << (s->cells[cell] - 1));
+    s->cells[cell] = 0;
+    s->rows[solver_cell_row[cell]]  &= bit;
+    s->cols[solver_cell_col[cell]]  &= bit;
+    s->boxes[solver_cell_box[cell]] &= bit;
+}
+
+// Loads a board into the state. Returns false if the givens already conflict.
+bool solver_state_init(SolverState *s, const Board b);
+void solver_state_to_board(const SolverState *s, Board b);
+
+typedef enum {
+    SOLVER_BACKTRACK,   // first empty cell, plain backtracking
+    SOLVER_DLX,         // Algorithm X over dancing links
+    SOLVER_MRV          // singles propagation + most constrained cell first
+} SolverEngine;
+
+// Engine used by solve(); defaults to SOLVER_MRV
+void solver_set_engine(SolverEngine engine);
+SolverEngine solver_get_engine(void);
+const char *solver_engine_name(SolverEngine engine);
+bool solver_engine_from_name(const char *name, SolverEngine *out);
+
+// Work done by one solve. Engines only count when the build defines
+// SUDOKU_SOLVER_STATS (CMake option, on by default); otherwise the
+// counting macros below compile to nothing and only elapsed_ns is set.
+typedef struct {
+    uint64_t nodes;         // search nodes entered
+    uint64_t backtracks;    // guesses that were undone
+    uint64_t propagations;  // cells filled by propagation (mrv only)
+    uint32_t max_depth;     // deepest guess nesting
+    uint64_t elapsed_ns;    // wall time of solve_with_stats()
+} SolverStats;
+
+// Counters of the solve running on this thread
+extern _Thread_local SolverStats solver_thread_stats;
+// Trace sink of this thread, see solver_set_trace()
+extern _Thread_local FILE *solver_trace_file;
+
+#ifdef SUDOKU_SOLVER_STATS
+#define SOLVER_STAT_ADD(field, n) (solver_thread_stats.field += (n))
+#define SOLVER_STAT_DEPTH(d)                                        \
+    do {                                                            \
+        if ((uint32_t)(d) > solver_thread_stats.max_depth)          \
+            solver_thread_stats.max_depth = (uint32_t)(d);          \
+    } while (0)
+// One line per search event: depth, event, cell as row letter + column
+#define SOLVER_TRACE(depth, event, cell, value)                     \
+    do {                                                            \
+        if (solver_trace_file)                                      \
+            solver_trace_event((depth), (event), (cell), (value));  \
+    } while (0)
+#else
+#define SOLVER_STAT_ADD(field, n)              ((void)0)
+#define SOLVER_STAT_DEPTH(d)                   ((void)0)
+#define SOLVER_TRACE(depth, event, cell, value) ((void)0)
+#endif
+
+void solver_trace_event(int depth, const char *event, int cell, int value);
+
+// Sends a line per guess/undo/propagation of this thread's solves to f
+// (NULL turns it off). Needs SUDOKU_SOLVER_STATS; returns false without it.
+bool solver_set_trace(FILE *f);
 
 bool solve(Board b);
+bool solve_with(Board b, SolverEngine engine);
+bool solve_with_stats(Board b, SolverEngine engine, SolverStats *stats);
 
 int solve_board(Board b);
+int solve_board_mrv(Board b);
 
-int solver_is_safe(const Board b, int row, int col, int value);
+// Number of solutions of b, counting stops at limit (2 is enough to tell
+// unique from ambiguous). 0 means unsolvable.
+int count_solutions(const Board b, int limit);
+// Same, and copies the first solution found into `first` (may be NULL)
+int solver_count(const Board b, int limit, Board first);
 
+// True if puzzle has exactly one solution and it is `solution`
+bool solver_verify_pair(const Board puzzle, const Board solution);
 
-#endif //SOLVER_H
+// True if naked and hidden singles alone fill the board (no guessing)
+bool solve_singles(const Board b);
 
+int solver_is_safe(const Board b, int row, int col, int value);
 
 
+#endif //SOLVER_H
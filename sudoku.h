@@ -5,12 +5,14 @@
 
 typedef enum {
     MODE_SERVER,
-    MODE_CLIENT
+    MODE_CLIENT,
+    MODE_SOLVE,
+    MODE_AUDIT,
+    MODE_GENERATE,
+    MODE_LOADGEN
 } ProgramMode;
 
 ProgramMode parse_mode(int argc, char *argv[], int *out_player_id);
-int run_server(void);
-int run_client(int player_id, const char *server_addr, int port);
 
 #endif //SUDOKU_H
 
@@ -0,0 +1,173 @@
+#include "timerwheel.h"
+
+#define TIMER_MASK  (TIMER_SLOTS - 1)
+#define TIMER_RANGE (1ull << (TIMER_SLOT_BITS * TIMER_LEVELS))
+
+static void list_init(Timer *head)
+{
+    head->prev = head->next = head;
+}
+
+static bool list_empty(const Timer *head)
+{
+    return head->next == head;
+}
+
+static void list_append(Timer *head, Timer *t)
+{
+    t->prev = head->prev;
+    t->next = head;
+    head->prev->next = t;
+    head->prev = t;
+}
+
+// Moves everything in from onto the empty list to
+static void list_take(Timer *to, Timer *from)
+{
+    if (list_empty(from))
+        return;
+    to->next = from->next;
+    to->prev = from->prev;
+    to->next->prev = to;
+    to->prev->next = to;
+    list_init(from);
+}
+
+static void timer_unlink(Timer *t)
+{
+    t->prev->next = t->next;
+    t->next->prev = t->prev;
+    t->prev = t->next = NULL;
+}
+
+void timerwheel_init(TimerWheel *w, uint64_t now_ns, unsigned tick_ms)
+{
+    for (int level = 0; level < TIMER_LEVELS; level++) {
+        for (int i = 0; i < TIMER_SLOTS; i++)
+            list_init(&w->slots[level][i]);
+    }
+    w->start_ns = now_ns;
+    w->tick_ns = (uint64_t)tick_ms * 1000000u;
+    w->now = 0;
+    w->count = 0;
+}
+
+void timer_init(Timer *t, TimerFn fn, void *arg)
+{
+    t->prev = t->next = NULL;
+    t->expires = 0;
+    t->fn = fn;
+    t->arg = arg;
+}
+
+bool timer_armed(const Timer *t)
+{
+    return t->next != NULL;
+}
+
+// Puts t in the slot for t->expires as seen from w->now: level 0 if it is
+// due within TIMER_SLOTS ticks, else the first level whose span covers it
+static void wheel_place(TimerWheel *w, Timer *t)
+{
+    if (t->expires < w->now)
+        t->expires = w->now;
+    if (t->expires - w->now >= TIMER_RANGE)
+        t->expires = w->now + TIMER_RANGE - 1;
+
+    uint64_t delta = t->expires - w->now;
+    int level = 0;
+    while (level < TIMER_LEVELS - 1 && delta >= 1ull << (TIMER_SLOT_BITS * (level + 1)))
+        level++;
+
+    unsigned slot = (unsigned)(t->expires >> (TIMER_SLOT_BITS * level)) & TIMER_MASK;
+    list_append(&w->slots[level][slot], t);
+}
+
+void timerwheel_add(TimerWheel *w, Timer *t, uint64_t deadline_ns)
+{
+    if (timer_armed(t))
+        timer_unlink(t);
+    else
+        w->count++;
+
+    // First tick at or after the deadline
+    uint64_t after = deadline_ns > w->start_ns ? deadline_ns - w->start_ns : 0;
+    t->expires = (after + w->tick_ns - 1) / w->tick_ns;
+    wheel_place(w, t);
+}
+
+void timerwheel_cancel(TimerWheel *w, Timer *t)
+{
+    if (!timer_armed(t))
+        return;
+    timer_unlink(t);
+    w->count--;
+}
+
+// Re-files one coarse slot now that its span has come round
+static void wheel_cascade(TimerWheel *w, int level, unsigned slot)
+{
+    Timer list;
+    list_init(&list);
+    list_take(&list, &w->slots[level][slot]);
+
+    while (!list_empty(&list)) {
+        Timer *t = list.next;
+        timer_unlink(t);
+        wheel_place(w, t);
+    }
+}
+
+void timerwheel_advance(TimerWheel *w, uint64_t now_ns)
+{
+    if (now_ns < w->start_ns)
+        return;
+    uint64_t last = (now_ns - w->start_ns) / w->tick_ns;
+
+    while (w->now <= last) {
+        if (w->count == 0) {
+            w->now = last + 1;
+            return;
+        }
+
+        // Each time a level wraps, the next slot of the level above is
+        // due within its span and comes down
+        unsigned index = (unsigned)w->now & TIMER_MASK;
+        for (int level = 1; index == 0 && level < TIMER_LEVELS; level++) {
+            index = (unsigned)(w->now >> (TIMER_SLOT_BITS * level)) & TIMER_MASK;
+            wheel_cascade(w, level, index);
+        }
+
+        // Fire from a private list so callbacks can re-arm into this slot
+        Timer due;
+        list_init(&due);
+        list_take(&due, &w->slots[0][w->now & TIMER_MASK]);
+        w->now++;
+
+        while (!list_empty(&due)) {
+            Timer *t = due.next;
+            timer_unlink(t);
+            w->count--;
+            t->fn(t);
+        }
+    }
+}
+
+int timerwheel_timeout_ms(const TimerWheel *w, uint64_t now_ns, int max_ms)
+{
+    if (w->count == 0)
+        return max_ms;
+
+    // The first busy level-0 slot, or the next wrap, where a cascade may
+    // bring something down (possibly the very next tick)
+    uint64_t tick = w->now;
+    while ((tick & TIMER_MASK) != 0 && list_empty(&w->slots[0][tick & TIMER_MASK]))
+        tick++;
+
+    uint64_t due_ns = w->start_ns + tick * w->tick_ns;
+    if (due_ns <= now_ns)
+        return 0;
+
+    uint64_t ms = (due_ns - now_ns + 999999) / 1000000;
+    return ms < (uint64_t)max_ms ? (int)ms : max_ms;
+}
@@ -0,0 +1,58 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Hierarchical timing wheel, in the style of the classic kernel timers:
+// TIMER_LEVELS wheels of TIMER_SLOTS lists, each level TIMER_SLOTS times
+// coarser than the one below. Arming, cancelling and firing a timer are
+// O(1) however many are pending; a timer far in the future waits in a
+// coarse slot and moves down a level as its time gets closer, at most once
+// per level. Timers live inside the objects they time, so nothing is
+// allocated. Not thread-safe: one wheel per event loop.
+
+#define TIMER_SLOT_BITS 6
+#define TIMER_SLOTS     (1 << TIMER_SLOT_BITS)
+#define TIMER_LEVELS    4   // 2^24 ticks: over 46 hours at 10 ms
+
+typedef struct Timer Timer;
+typedef void (*TimerFn)(Timer *t);
+
+struct Timer {
+    Timer *prev, *next;     // slot list; NULL while not armed
+    uint64_t expires;       // tick
+    TimerFn fn;
+    void *arg;
+};
+
+typedef struct {
+    Timer slots[TIMER_LEVELS][TIMER_SLOTS];     // list heads
+    uint64_t start_ns;
+    uint64_t tick_ns;
+    uint64_t now;           // next tick to run
+    size_t count;           // armed timers
+} TimerWheel;
+
+void timerwheel_init(TimerWheel *w, uint64_t now_ns, unsigned tick_ms);
+
+void timer_init(Timer *t, TimerFn fn, void *arg);
+bool timer_armed(const Timer *t);
+
+// Arms t to fire once deadline_ns has passed, moving it if it was armed.
+// Deadlines further out than the wheel reaches fire at its far end.
+void timerwheel_add(TimerWheel *w, Timer *t, uint64_t deadline_ns);
+
+// Does nothing if t is not armed
+void timerwheel_cancel(TimerWheel *w, Timer *t);
+
+// Fires every timer whose tick has passed by now_ns. Callbacks may arm and
+// cancel timers, themselves and others included.
+void timerwheel_advance(TimerWheel *w, uint64_t now_ns);
+
+// How long an event loop can wait before the next timer needs
+// timerwheel_advance(), capped at max_ms
+int timerwheel_timeout_ms(const TimerWheel *w, uint64_t now_ns, int max_ms);
+
+#endif //TIMERWHEEL_H
@@ -0,0 +1,15 @@
+#ifndef TIMEUTIL_H
+#define TIMEUTIL_H
+
+#include <stdint.h>
+#include <time.h>
+
+// Monotonic clock in nanoseconds, for measuring intervals
+static inline uint64_t time_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+#endif //TIMEUTIL_H